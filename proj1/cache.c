@@ -0,0 +1,428 @@
+/**
+   @file cache.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   A directory of images pie has drawn before.  Each image is in a file named for a hash of
+   its key, starting with the key on a line of its own so a hash collision is just a miss.
+   A file's modification time is when it was last used, so the least recently used images
+   are the oldest files.  Images are written under a temporary name and renamed into place,
+   and the counters file is locked while it's updated or the directory is trimmed, so
+   more than one run of pie can share a cache.
+ */
+
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+/** Suffix of the files holding images. */
+#define SUFFIX ".img"
+
+/** Name of the file holding the counters. */
+#define COUNTERS "counters"
+
+/** Number of counters kept, for hits, misses and evictions. */
+#define COUNTS 3
+
+/** Size of the buffer for copying an image when it can't be sent directly. */
+#define COPY_BLOCK 65536
+
+/** An image file in the cache, when looking for the least recently used ones. */
+typedef struct {
+  char *name;
+  long long bytes;
+  struct timespec used;
+} Stored;
+
+bool openCache(Cache *cache, char const *dir, long long limit)
+{
+  cache->dir = dir;
+  cache->limit = limit;
+  return mkdir(dir, 0777) == 0 || errno == EEXIST;
+}
+
+/**
+   Return the greatest common divisor of two numbers.
+   @param a a number, zero or more.
+   @param b another number, zero or more.
+   @return their greatest common divisor, or zero if both are zero.
+ */
+static int gcd(int a, int b)
+{
+  while (b != 0) {
+    int r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+void makeKey(char *key, int size, char const *format, bool smooth, int const *sizes, int slices)
+{
+  int divisor = 0;
+  for (int k = 0; k < slices; k++) {
+    divisor = gcd(divisor, sizes[k]);
+  }
+  int len = snprintf(key, CACHE_KEY, "pie1 %d %s %c", size, format, smooth ? 'a' : '-');
+  for (int k = 0; k < slices; k++) {
+    len += snprintf(key + len, CACHE_KEY - len, " %d", sizes[k] / divisor);
+  }
+}
+
+/**
+   Return the path of a file in the cache directory.
+   @param cache the cache.
+   @param name name of the file.
+   @return the path, which the caller must free.
+ */
+static char *pathOf(Cache const *cache, char const *name)
+{
+  size_t len = strlen(cache->dir) + strlen(name) + 2;
+  char *path = malloc(len);
+  if (!path) {
+    perror("pie");
+    exit(EXIT_FAILURE);
+  }
+  snprintf(path, len, "%s/%s", cache->dir, name);
+  return path;
+}
+
+/**
+   Return the path of the file for an image, named for the FNV-1a hash of its key.
+   @param cache the cache.
+   @param key key of the image.
+   @return the path, which the caller must free.
+ */
+static char *entryPath(Cache const *cache, char const *key)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (char const *p = key; *p; p++) {
+    hash = (hash ^ (unsigned char) *p) * 1099511628211ULL;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx" SUFFIX, (unsigned long long) hash);
+  return pathOf(cache, name);
+}
+
+/**
+   Open the counters file and lock it, so only this run of pie changes the counters
+   or the images in the cache until it's unlocked.
+   @param cache the cache.
+   @return a file descriptor for the counters file, or -1 if it can't be opened.
+ */
+static int lockCounters(Cache const *cache)
+{
+  char *path = pathOf(cache, COUNTERS);
+  int fd = open(path, O_RDWR | O_CREAT, 0666);
+  free(path);
+  if (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+   Read the counters from a locked counters file.
+   @param fd file descriptor for the counters file.
+   @param counts set to the hits, misses and evictions, zero for any that aren't there.
+ */
+static void readCounters(int fd, long long counts[COUNTS])
+{
+  char buf[256];
+  ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+  buf[n > 0 ? n : 0] = '\0';
+  counts[0] = counts[1] = counts[2] = 0;
+  sscanf(buf, "hits %lld misses %lld evictions %lld", &counts[0], &counts[1], &counts[2]);
+}
+
+/**
+   Add to the counters in a locked counters file.
+   @param fd file descriptor for the counters file.
+   @param add amounts to add to the hits, misses and evictions.
+ */
+static void addCounters(int fd, long long const add[COUNTS])
+{
+  long long counts[COUNTS];
+  readCounters(fd, counts);
+  char buf[256];
+  int len = snprintf(buf, sizeof(buf), "hits %lld\nmisses %lld\nevictions %lld\n",
+                     counts[0] + add[0], counts[1] + add[1], counts[2] + add[2]);
+  if (ftruncate(fd, 0) != 0 || pwrite(fd, buf, len, 0) != len) {
+    perror("pie: cache counters");
+  }
+}
+
+/**
+   Add to the counters of a cache.
+   @param cache the cache.
+   @param hits number of hits to add.
+   @param misses number of misses to add.
+ */
+static void count(Cache const *cache, int hits, int misses)
+{
+  int fd = lockCounters(cache);
+  if (fd < 0) {
+    perror("pie: cache counters");
+    return;
+  }
+  long long add[COUNTS] = { hits, misses, 0 };
+  addCounters(fd, add);
+  close(fd);
+}
+
+/**
+   Open an image file and check it holds the image for the given key.
+   @param path path of the file.
+   @param key key of the image.
+   @param len set to the length of the image.
+   @return a file descriptor positioned at the start of the image, or -1 if it isn't the image.
+ */
+static int openImage(char const *path, char const *key, size_t *len)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  size_t header = strlen(key) + 1;
+  char buf[CACHE_KEY + 1];
+  struct stat st;
+  if (read(fd, buf, header) != (ssize_t) header || memcmp(buf, key, header - 1) != 0
+      || buf[header - 1] != '\n' || fstat(fd, &st) != 0 || (size_t) st.st_size < header) {
+    close(fd);
+    return -1;
+  }
+  *len = st.st_size - header;
+  return fd;
+}
+
+int findEntry(Cache const *cache, char const *key, size_t *len)
+{
+  char *path = entryPath(cache, key);
+  int fd = openImage(path, key, len);
+  free(path);
+  if (fd < 0) {
+    count(cache, 0, 1);
+    return -1;
+  }
+
+  // Mark it as just used.
+  futimens(fd, NULL);
+  count(cache, 1, 0);
+  return fd;
+}
+
+bool startEntry(Cache const *cache, Entry *entry, char const *key)
+{
+  snprintf(entry->key, CACHE_KEY, "%s", key);
+  entry->temp = pathOf(cache, ".new.XXXXXX");
+  int fd = mkstemp(entry->temp);
+  if (fd < 0) {
+    free(entry->temp);
+    return false;
+  }
+  entry->fp = fdopen(fd, "wb");
+  if (!entry->fp) {
+    close(fd);
+    unlink(entry->temp);
+    free(entry->temp);
+    return false;
+  }
+  fprintf(entry->fp, "%s\n", key);
+  return true;
+}
+
+/**
+   Order stored images from the least recently used to the most.
+   @param a pointer to one stored image.
+   @param b pointer to another.
+   @return negative, zero or positive as a was used before, at the same time as, or after b.
+ */
+static int olderFirst(void const *a, void const *b)
+{
+  struct timespec const *x = &((Stored const *) a)->used;
+  struct timespec const *y = &((Stored const *) b)->used;
+  if (x->tv_sec != y->tv_sec) {
+    return x->tv_sec < y->tv_sec ? -1 : 1;
+  }
+  return x->tv_nsec < y->tv_nsec ? -1 : x->tv_nsec > y->tv_nsec;
+}
+
+/**
+   List the image files in a cache.
+   @param cache the cache.
+   @param count set to the number of images.
+   @param bytes set to their total size.
+   @return the images, which the caller must free along with their names.
+ */
+static Stored *listImages(Cache const *cache, int *count, long long *bytes)
+{
+  *count = 0;
+  *bytes = 0;
+  int cap = 16;
+  Stored *list = malloc(cap * sizeof(Stored));
+  DIR *dir = opendir(cache->dir);
+  if (!list || !dir) {
+    if (dir) {
+      closedir(dir);
+    }
+    return list;
+  }
+  struct dirent *ent;
+  size_t suffix = strlen(SUFFIX);
+  while ((ent = readdir(dir)) != NULL) {
+    size_t n = strlen(ent->d_name);
+    struct stat st;
+    if (n <= suffix || strcmp(ent->d_name + n - suffix, SUFFIX) != 0
+        || fstatat(dirfd(dir), ent->d_name, &st, 0) != 0) {
+      continue;
+    }
+    if (*count == cap) {
+      cap *= 2;
+      Stored *bigger = realloc(list, cap * sizeof(Stored));
+      if (!bigger) {
+        break;
+      }
+      list = bigger;
+    }
+    list[*count].name = strdup(ent->d_name);
+    list[*count].bytes = st.st_size;
+    list[*count].used = st.st_mtim;
+    *bytes += st.st_size;
+    (*count)++;
+  }
+  closedir(dir);
+  return list;
+}
+
+/**
+   Remove the least recently used images until the cache is under its limit.
+   The counters file must be locked.
+   @param cache the cache.
+   @param fd file descriptor for the counters file.
+ */
+static void trim(Cache const *cache, int fd)
+{
+  int stored;
+  long long bytes;
+  Stored *list = listImages(cache, &stored, &bytes);
+  if (!list) {
+    return;
+  }
+  qsort(list, stored, sizeof(Stored), olderFirst);
+  long long add[COUNTS] = { 0, 0, 0 };
+  for (int i = 0; i < stored && bytes > cache->limit; i++) {
+    char *path = pathOf(cache, list[i].name);
+    if (unlink(path) == 0) {
+      bytes -= list[i].bytes;
+      add[2]++;
+    }
+    free(path);
+  }
+  if (add[2] > 0) {
+    addCounters(fd, add);
+  }
+  for (int i = 0; i < stored; i++) {
+    free(list[i].name);
+  }
+  free(list);
+}
+
+int finishEntry(Cache const *cache, Entry *entry, size_t *len)
+{
+  char *path = entryPath(cache, entry->key);
+  int fd = -1;
+  if (fclose(entry->fp) == 0 && rename(entry->temp, path) == 0) {
+    fd = openImage(path, entry->key, len);
+  }
+  else {
+    int saved = errno;
+    unlink(entry->temp);
+    errno = saved;
+  }
+  free(path);
+  free(entry->temp);
+  if (fd < 0) {
+    return -1;
+  }
+
+  // The new image is open already, so it can be copied out even if it's evicted at once.
+  int lock = lockCounters(cache);
+  if (lock >= 0) {
+    trim(cache, lock);
+    close(lock);
+  }
+  return fd;
+}
+
+bool copyEntry(int fd, size_t len, int out)
+{
+  bool ok = true;
+  while (len > 0) {
+    ssize_t n = sendfile(out, fd, NULL, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    len -= n;
+  }
+
+  // Not every kind of file can be sent to, so copy whatever's left the slow way.
+  char *buf = len > 0 ? malloc(COPY_BLOCK) : NULL;
+  if (len > 0 && !buf) {
+    ok = false;
+  }
+  while (ok && len > 0) {
+    ssize_t n = read(fd, buf, len < COPY_BLOCK ? len : COPY_BLOCK);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      ok = false;
+      break;
+    }
+    for (ssize_t done = 0; ok && done < n; ) {
+      ssize_t w = write(out, buf + done, n - done);
+      if (w < 0 && errno != EINTR) {
+        ok = false;
+      }
+      done += w > 0 ? w : 0;
+    }
+    len -= n;
+  }
+  free(buf);
+  int saved = errno;
+  close(fd);
+  errno = saved;
+  return ok;
+}
+
+void printCounters(Cache const *cache, FILE *fp)
+{
+  long long counts[COUNTS] = { 0, 0, 0 };
+  int fd = lockCounters(cache);
+  if (fd >= 0) {
+    readCounters(fd, counts);
+  }
+  int stored = 0;
+  long long bytes = 0;
+  Stored *list = listImages(cache, &stored, &bytes);
+  if (fd >= 0) {
+    close(fd);
+  }
+  for (int i = 0; i < stored; i++) {
+    free(list[i].name);
+  }
+  free(list);
+  fprintf(fp, "hits %lld\nmisses %lld\nevictions %lld\nimages %d\nbytes %lld\n",
+          counts[0], counts[1], counts[2], stored, bytes);
+}
@@ -0,0 +1,111 @@
+/**
+   @file cache.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the cache.c component, a directory of images pie has already drawn,
+   so a chart it's asked for again can be copied out instead of drawn.  Charts are keyed by
+   their slice sizes reduced to lowest terms, since 1 1 1 and 2 2 2 draw the same image.
+   The directory is kept under a limit in bytes by removing the least recently used images,
+   and it keeps counts of hits, misses and evictions that any run of pie can report.
+ */
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/** Largest length of a key, with room for the largest number of slices. */
+#define CACHE_KEY 1024
+
+/** Default limit on the bytes of images kept in a cache. */
+#define CACHE_LIMIT (64LL << 20)
+
+/** A cache directory and the limit on its size. */
+typedef struct {
+  /** Path of the directory. */
+  char const *dir;
+
+  /** Most bytes of images to keep in it. */
+  long long limit;
+} Cache;
+
+/** An image being added to a cache. */
+typedef struct {
+  /** File the image is written to, and its temporary name until it's finished. */
+  FILE *fp;
+  char *temp;
+
+  /** Key of the image. */
+  char key[CACHE_KEY];
+} Entry;
+
+/**
+   Open the given cache, making its directory if there isn't one.
+   @param cache cache to open.
+   @param dir path of the directory.
+   @param limit most bytes of images to keep in it.
+   @return false, with errno set, if the directory can't be made.
+ */
+bool openCache(Cache *cache, char const *dir, long long limit);
+
+/**
+   Make the key for a chart.  The slice sizes are divided by their greatest common divisor,
+   so charts with the same proportions get the same key.
+   @param key set to the key, CACHE_KEY bytes at most.
+   @param size width and height of the image.
+   @param format name of the image's format.
+   @param smooth true if the edges are anti-aliased.
+   @param sizes relative sizes of the slices, none negative and not all zero.
+   @param slices number of slices.
+ */
+void makeKey(char *key, int size, char const *format, bool smooth, int const *sizes, int slices);
+
+/**
+   Look up an image in the cache, counting a hit or a miss.  An image that's found is marked
+   as the most recently used.
+   @param cache cache to look in.
+   @param key key of the image.
+   @param len set to the length of the image, if it's found.
+   @return a file descriptor to read the image from, or -1 if it isn't in the cache.
+ */
+int findEntry(Cache const *cache, char const *key, size_t *len);
+
+/**
+   Start adding an image to the cache.  The image is written to entry->fp and added
+   by finishEntry(), so no other run of pie ever sees part of it.
+   @param cache cache to add to.
+   @param entry set up for writing the image.
+   @param key key of the image.
+   @return false, with errno set, if the file for the image couldn't be made.
+ */
+bool startEntry(Cache const *cache, Entry *entry, char const *key);
+
+/**
+   Finish adding an image to the cache, then remove the least recently used images
+   until the cache is back under its limit.
+   @param cache cache to add to.
+   @param entry image to add, with the whole image written to it.
+   @param len set to the length of the image.
+   @return a file descriptor to read the image from, or -1, with errno set, if it couldn't be added.
+ */
+int finishEntry(Cache const *cache, Entry *entry, size_t *len);
+
+/**
+   Copy an image from the cache to a file descriptor.
+   @param fd file descriptor findEntry() or finishEntry() gave for the image, which is closed.
+   @param len length of the image.
+   @param out file descriptor to copy it to.
+   @return false, with errno set, if it couldn't be copied.
+ */
+bool copyEntry(int fd, size_t len, int out);
+
+/**
+   Print the counts of hits, misses and evictions for the cache,
+   and the number and total size of the images in it.
+   @param cache cache to report on.
+   @param fp file to print to.
+ */
+void printCounters(Cache const *cache, FILE *fp);
+
+#endif
@@ -2,47 +2,864 @@
    @file dent.c
    @author Xiaohui Z Ellis (xzheng6)
 
-   This program reads text from standard input,
+   This program reads text from standard input, or from a file named on the command line,
    and prints out correctly indented code based on the nesting of curly brackets.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-
-/** Two-space indenting. */
-#define INDENT 2
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <ftw.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dentlib.h"
+#include "pipeline.h"
 
 /** Exit code for invalid input. */
 #define EXIT_UNSUCCESS 100
 
-/** Level of indentation. */
-int depth = 0;
+/** Number of bytes read from standard input at a time. */
+#define READ_SIZE 65536
+
+/** Largest number of threads the parallel mode will use. */
+#define MAX_THREADS 256
+
+/** Number of file names the batch mode makes room for at first. */
+#define INITIAL_FILES 8192
+
+/** Largest number of directories nftw() holds open at once while walking a tree. */
+#define WALK_FDS 64
+
+/** By default, a checkpoint is recorded in the index every 256 lines. */
+#define CHECKPOINT_LINES 256
+
+/** First bytes of a checkpoint index file, to recognize one. */
+#define INDEX_MAGIC "DENTIDX3"
+
+/** Profile of the input, with -p, reported on standard error however the program exits. */
+Profile report;
+
+/**
+   Print the profile of the input to standard error.
+ */
+void printReport()
+{
+  printProfile(stderr, &report);
+}
+
+/**
+   Flush the given output, and exit if any of it couldn't be written.
+   @param out output to flush.
+ */
+void finishOut(Output *out)
+{
+  if (!flushOut(out)) {
+    errno = out->error;
+    perror("write");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+   Report input that doesn't have matching opening and closing curly brackets,
+   after everything printed so far, and exit.
+   @param out output everything has been printed to.
+ */
+void unmatched(Output *out)
+{
+  static char const msg[] = "Unmatched brackets\n";
+  emit(out, msg, sizeof(msg) - 1);
+  finishOut(out);
+  exit(EXIT_UNSUCCESS);
+}
+
+/**
+   Hand the given block of output to the file descriptor the context points to.
+   @param context pointer to the file descriptor to write to.
+   @param buf block of output.
+   @param len number of bytes in the block.
+   @return false, with errno set, if the output couldn't be written.
+ */
+bool writeSink(void *context, char const *buf, size_t len)
+{
+  return writeAll(*(int *) context, buf, len);
+}
+
+/**
+   Feed everything that can be read from the given file descriptor to the given state,
+   a block at a time, and finish it.
+   @param dent state to indent with.
+   @param fd file descriptor to read from.
+   @return how indenting the input turned out.
+ */
+DentStatus indentStream(DentState *dent, int fd)
+{
+  static char inBuffer[READ_SIZE];
+  Profile *profile = dent->ind.profile;
+  ssize_t n;
+  double start = profile ? profileClock() : 0;
+  while ((n = read(fd, inBuffer, READ_SIZE)) != 0) {
+    if (profile) {
+      profile->readTime += profileClock() - start;
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("read");
+      exit(EXIT_FAILURE);
+    }
+    if (dentFeed(dent, inBuffer, n) != DentOk) {
+      return dent->status;
+    }
+    start = profile ? profileClock() : 0;
+  }
+  if (profile) {
+    profile->readTime += profileClock() - start;
+  }
+  return dentFinish(dent);
+}
+
+/** What one chunk of input does to the nesting depth, given how the chunk starts. */
+typedef struct {
+  /** Change in depth from the start of the chunk to the end. */
+  int delta;
+
+  /** Lowest depth reached, relative to the start of the chunk. */
+  int low;
+
+  /** State the chunk ends in. */
+  ScanState state;
+} ChunkSummary;
+
+/** A piece of the input that's handled by its own thread in the parallel mode. */
+typedef struct {
+  /** Text of the chunk, which always starts at the beginning of a line. */
+  char const *text;
+
+  /** Number of bytes in the chunk. */
+  size_t len;
+
+  /** Summary of the chunk for each state it could start in. */
+  ChunkSummary from[STATE_COUNT];
+
+  /** Indentation state the chunk starts in, and ends in once it's been indented. */
+  Indenter ind;
+
+  /** Indented text for the chunk. */
+  Output out;
+
+  /** False if the chunk has an unmatched closing curly bracket. */
+  bool ok;
+
+  /** Profile of the chunk, with -p. */
+  Profile profile;
+} Chunk;
+
+/**
+   Work out how the given text changes the nesting depth, without producing any output.
+   @param buf text to summarize.
+   @param len number of bytes in the text.
+   @param state state the text starts in.
+   @param lex state machine deciding which curly brackets count.
+   @return summary of the text.
+ */
+ChunkSummary summarize(char const *buf, size_t len, ScanState state, Lexer const *lex)
+{
+  ChunkSummary sum = { 0, 0, state };
+  size_t i = 0;
+  while (i < len) {
+    ScanSet const *stops = lex->stops[sum.state];
+    size_t j = stops ? i + findInSet(buf + i, len - i, stops) : i;
+    if (j == len) {
+      break;
+    }
+    Transition t = lex->table[sum.state][lex->classOf[(unsigned char) buf[j]]];
+    sum.delta += t.delta;
+    if (sum.delta < sum.low) {
+      sum.low = sum.delta;
+    }
+    sum.state = t.next;
+    i = j + 1;
+  }
+  return sum;
+}
 
 /**
-   Print out spaces to properly indent the start of a line to an indentation depth of d.
-   @param d the indentation depth.
+   Thread body for the first pass of the parallel mode,
+   summarizing a chunk for every state it could start in.
+   @param arg the chunk to summarize.
+   @return NULL.
  */
-void indent(int d)
+void *summarizeChunk(void *arg)
 {
-  for (int i = 0; i < INDENT*d; i++) {
-    putchar(' ');
+  Chunk *chunk = arg;
+  Lexer const *lex = chunk->ind.lex;
+  for (int s = 0; s < STATE_COUNT; s++) {
+    if (lex->lineEntry[s]) {
+      chunk->from[s] = summarize(chunk->text, chunk->len, s, lex);
+    }
   }
+  return NULL;
+}
+
+/**
+   Thread body for the second pass of the parallel mode, indenting a chunk into its own output.
+   @param arg the chunk to indent.
+   @return NULL.
+ */
+void *indentChunk(void *arg)
+{
+  Chunk *chunk = arg;
+  chunk->ok = indentBlock(&chunk->ind, chunk->text, chunk->len);
+  return NULL;
 }
 
 /**
-   Return true if the given ch is either a space or a tab character.
-   @param ch the character to check.
-   @return true if the given ch is either a space or a tab character.
+   Run the given function on each of the given chunks, each in its own thread.
+   @param chunks chunks to work on.
+   @param count number of chunks.
+   @param func thread body to run on each chunk.
  */
-bool isASpace(char ch)
+void runChunks(Chunk *chunks, int count, void *(*func)(void *))
 {
-  return ch == ' ' || ch == '\t';
+  pthread_t threads[MAX_THREADS];
+  for (int i = 1; i < count; i++) {
+    if (pthread_create(&threads[i], NULL, func, &chunks[i]) != 0) {
+      perror("pthread_create");
+      exit(EXIT_FAILURE);
+    }
+  }
+  func(&chunks[0]);
+  for (int i = 1; i < count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
+
+/**
+   Indent the given text in parallel.  The text is split into chunks at line boundaries,
+   then each thread works out how its chunk changes the nesting depth,
+   for every state the lexer can be in at the start of a line (inside a string or not, for example).
+   A pass over those summaries finds the depth and state each chunk really starts in,
+   and the first chunk where the depth goes negative.
+   Then the chunks are indented in parallel and their output is written in order.
+   This gives exactly the same output and exit status as indenting the text serially.
+   @param text text to indent.
+   @param len number of bytes in the text.
+   @param threads number of threads to use.
+   @param lex state machine deciding which curly brackets count.
+   @param policy how lines are indented.
+   @param profile profile to add each chunk's profile to, or NULL.
+   @return exit status for the program.
+ */
+int indentParallel(char const *text, size_t len, int threads, Lexer const *lex,
+                   Policy const *policy, Profile *profile)
+{
+  Chunk chunks[MAX_THREADS];
+  int count = 0;
+  size_t start = 0;
+  while (start < len && count < threads) {
+    size_t end = len;
+    if (count < threads - 1) {
+      end = start + (len - start) / (threads - count);
+      char const *newline = memchr(text + end, '\n', len - end);
+      end = newline ? newline - text + 1 : len;
+    }
+    chunks[count].text = text + start;
+    chunks[count].len = end - start;
+    chunks[count].ind.lex = lex;
+    chunks[count].ind.policy = policy;
+    resumeAt(&chunks[count].ind, text, start);
+    count++;
+    start = end;
+  }
+  if (count == 0) {
+    return EXIT_SUCCESS;
+  }
+
+  runChunks(chunks, count, summarizeChunk);
+
+  // Work out where each chunk starts, stopping at the first one with an unmatched bracket.
+  int depth = 0;
+  ScanState state = LineStart;
+  int used = 0;
+  while (used < count) {
+    Chunk *chunk = &chunks[used];
+    ChunkSummary *sum = &chunk->from[state];
+    chunk->ind.depth = depth;
+    chunk->ind.state = state;
+    chunk->ind.out = &chunk->out;
+    chunk->ind.index = NULL;
+    chunk->ind.lines = 0;
+    chunk->ind.profile = profile ? &chunk->profile : NULL;
+    initProfile(&chunk->profile);
+    initOutput(&chunk->out, -1, true);
+    used++;
+    if (depth + sum->low < 0) {
+      break;
+    }
+    depth += sum->delta;
+    state = sum->state;
+  }
+
+  runChunks(chunks, used, indentChunk);
+
+  Output out;
+  initOutput(&out, STDOUT_FILENO, false);
+  out.profile = profile;
+  bool ok = true;
+  for (int i = 0; i < used; i++) {
+    if (profile) {
+      finishProfile(&chunks[i].profile);
+      mergeProfile(profile, &chunks[i].profile);
+    }
+    double start = profile ? profileClock() : 0;
+    if (!writePieces(STDOUT_FILENO, chunks[i].out.pieces, chunks[i].out.count)) {
+      perror("write");
+      exit(EXIT_FAILURE);
+    }
+    if (profile) {
+      profile->writeTime += profileClock() - start;
+    }
+    ok = ok && chunks[i].ok;
+    freeOutput(&chunks[i].out);
+  }
+  if (!ok || !finishIndent(&chunks[used - 1].ind)) {
+    unmatched(&out);
+  }
+  freeOutput(&out);
+  return EXIT_SUCCESS;
+}
+
+/**
+   Read everything from the given file descriptor into one dynamically allocated block.
+   @param fd file descriptor to read from.
+   @param len set to the number of bytes read.
+   @return the text that was read.
+ */
+char *readAll(int fd, size_t *len)
+{
+  size_t cap = READ_SIZE;
+  char *text = malloc(cap);
+  *len = 0;
+  ssize_t n;
+  while ((n = read(fd, text + *len, cap - *len)) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("read");
+      exit(EXIT_FAILURE);
+    }
+    *len += n;
+    if (*len == cap) {
+      cap *= 2;
+      text = realloc(text, cap);
+    }
+  }
+  return text;
+}
+
+/** How indenting one file in the batch mode turned out. */
+typedef enum {
+  /** The file was indented and written out. */
+  FileIndented,
+
+  /** The file was already indented correctly, so it was left alone. */
+  FileUnchanged,
+
+  /** The file has unmatched curly brackets, so it was left alone. */
+  FileUnmatched,
+
+  /** The file couldn't be read or its output couldn't be written. */
+  FileFailed
+} FileStatus;
+
+/** A list of files to indent in the batch mode, and how each of them turned out. */
+typedef struct {
+  /** Names of the files to indent. */
+  char **paths;
+
+  /** Number of files, and how many there's room for. */
+  int count;
+  int cap;
+
+  /** Outcome for each file. */
+  FileStatus *status;
+
+  /** Directory the files were found under, used to name their outputs, or NULL. */
+  char const *root;
+
+  /** Directory to write indented files to, or NULL to replace them in place. */
+  char const *outDir;
+
+  /** State machine deciding which curly brackets count. */
+  Lexer const *lex;
+
+  /** How lines are indented. */
+  Policy const *policy;
+
+  /** Index of the next file a worker should pick up, and a lock protecting it. */
+  int next;
+  pthread_mutex_t lock;
+} Batch;
+
+/** Batch that nftw() is adding files to, since its callback can't be given one. */
+Batch *walking;
+
+/**
+   Add a copy of the given file name to the given batch.
+   @param batch batch to add to.
+   @param path name of the file.
+ */
+void addFile(Batch *batch, char const *path)
+{
+  if (batch->count == batch->cap) {
+    batch->cap = batch->cap ? batch->cap * 2 : INITIAL_FILES;
+    batch->paths = realloc(batch->paths, batch->cap * sizeof(char *));
+  }
+  batch->paths[batch->count++] = strdup(path);
+}
+
+/**
+   Return true if the given file name ends in .c or .h, the only files the batch mode indents.
+   @param path name of the file.
+   @return true if the file is C source.
+ */
+bool isSource(char const *path)
+{
+  size_t len = strlen(path);
+  return len > 2 && path[len - 2] == '.' && (path[len - 1] == 'c' || path[len - 1] == 'h');
+}
+
+/**
+   Callback for nftw(), adding C source files to the batch being built
+   and skipping hidden directories like .git.
+   @param path name of the file.
+   @param st information about the file.
+   @param type what kind of file it is.
+   @param ftw position of the file's base name in path, and its depth in the tree.
+   @return whether to keep walking and whether to look inside this directory.
+ */
+int walkFile(char const *path, struct stat const *st, int type, struct FTW *ftw)
+{
+  char const *name = path + ftw->base;
+  if (type == FTW_D && ftw->level > 0 && name[0] == '.') {
+    return FTW_SKIP_SUBTREE;
+  }
+  if (type == FTW_F && S_ISREG(st->st_mode) && isSource(name)) {
+    addFile(walking, path);
+  }
+  return FTW_CONTINUE;
+}
+
+/**
+   Create the given directory and any of its parents that don't exist yet.
+   @param dir name of the directory.
+   @return false if a directory couldn't be created.
+ */
+bool makeDirs(char *dir)
+{
+  for (char *slash = strchr(dir + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    bool ok = mkdir(dir, 0777) == 0 || errno == EEXIST;
+    *slash = '/';
+    if (!ok) {
+      return false;
+    }
+  }
+  return mkdir(dir, 0777) == 0 || errno == EEXIST;
+}
+
+/**
+   Replace the file with the given name by the given text, by writing the text to a temporary file
+   in the same directory and renaming it over the original, so a failure never leaves half a file.
+   @param dest name of the file to write.
+   @param text contents for the file.
+   @param len number of bytes in the text.
+   @param mode permissions for the file.
+   @return false if the file couldn't be written.
+ */
+bool replaceFile(char const *dest, char const *text, size_t len, mode_t mode)
+{
+  char *temp = malloc(strlen(dest) + sizeof(".dent-XXXXXX"));
+  sprintf(temp, "%s.dent-XXXXXX", dest);
+  int fd = mkstemp(temp);
+  if (fd < 0) {
+    free(temp);
+    return false;
+  }
+  bool ok = fchmod(fd, mode & 07777) == 0 && writeAll(fd, text, len);
+  ok = close(fd) == 0 && ok;
+  ok = ok && rename(temp, dest) == 0;
+  if (!ok) {
+    unlink(temp);
+  }
+  free(temp);
+  return ok;
+}
+
+/**
+   Indent one file of a batch, writing it in place or under the batch's output directory.
+   Files with unmatched curly brackets are left alone,
+   and so are files that are already indented correctly when they're being replaced in place.
+   @param batch batch the file belongs to.
+   @param path name of the file.
+   @return how indenting the file turned out.
+ */
+FileStatus indentOneFile(Batch *batch, char const *path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return FileFailed;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return FileFailed;
+  }
+  size_t len = st.st_size;
+  char *text = "";
+  if (len > 0) {
+    text = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) {
+      close(fd);
+      return FileFailed;
+    }
+  }
+  close(fd);
+
+  Output out;
+  initOutput(&out, -1, false);
+  Indenter ind = { 0, LineStart, batch->lex, batch->policy, &out, NULL, 0, false, '\n' };
+  FileStatus status = FileIndented;
+  if (!indentBlock(&ind, text, len) || !finishIndent(&ind)) {
+    status = FileUnmatched;
+  }
+  else if (!batch->outDir && out.len == len && memcmp(out.data, text, len) == 0) {
+    status = FileUnchanged;
+  }
+  else if (!batch->outDir) {
+    if (!replaceFile(path, out.data, out.len, st.st_mode)) {
+      status = FileFailed;
+    }
+  }
+  else {
+    // Name the output after the file's path below the directory that was walked.
+    char const *rel = path;
+    size_t rootLen = batch->root ? strlen(batch->root) : 0;
+    if (rootLen && strncmp(path, batch->root, rootLen) == 0) {
+      rel = path + rootLen;
+    }
+    while (*rel == '/') {
+      rel++;
+    }
+    char *dest = malloc(strlen(batch->outDir) + strlen(rel) + 2);
+    sprintf(dest, "%s/%s", batch->outDir, rel);
+    char *slash = strrchr(dest, '/');
+    *slash = '\0';
+    bool ok = makeDirs(dest);
+    *slash = '/';
+    if (!ok || !replaceFile(dest, out.data, out.len, st.st_mode)) {
+      status = FileFailed;
+    }
+    free(dest);
+  }
+
+  freeOutput(&out);
+  if (len > 0) {
+    munmap(text, len);
+  }
+  return status;
+}
+
+/**
+   Thread body for the batch mode's workers,
+   each of which keeps picking up the next file until there are none left.
+   @param arg the batch.
+   @return NULL.
+ */
+void *batchWorker(void *arg)
+{
+  Batch *batch = arg;
+  while (true) {
+    pthread_mutex_lock(&batch->lock);
+    int i = batch->next++;
+    pthread_mutex_unlock(&batch->lock);
+    if (i >= batch->count) {
+      return NULL;
+    }
+    batch->status[i] = indentOneFile(batch, batch->paths[i]);
+  }
+}
+
+/**
+   Indent every file in the given batch with a fixed-size pool of worker threads,
+   then report the files that couldn't be indented and a summary on standard error.
+   @param batch files to indent.
+   @param threads number of worker threads.
+   @return exit status for the program,
+   EXIT_UNSUCCESS if any file has unmatched curly brackets.
+ */
+int indentBatch(Batch *batch, int threads)
+{
+  batch->status = malloc((batch->count + 1) * sizeof(FileStatus));
+  batch->next = 0;
+  pthread_mutex_init(&batch->lock, NULL);
+
+  pthread_t workers[MAX_THREADS];
+  for (int i = 1; i < threads; i++) {
+    if (pthread_create(&workers[i], NULL, batchWorker, batch) != 0) {
+      perror("pthread_create");
+      exit(EXIT_FAILURE);
+    }
+  }
+  batchWorker(batch);
+  for (int i = 1; i < threads; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  pthread_mutex_destroy(&batch->lock);
+
+  int tally[FileFailed + 1] = { 0 };
+  for (int i = 0; i < batch->count; i++) {
+    tally[batch->status[i]]++;
+    if (batch->status[i] == FileUnmatched) {
+      fprintf(stderr, "%s: Unmatched brackets\n", batch->paths[i]);
+    }
+    else if (batch->status[i] == FileFailed) {
+      fprintf(stderr, "%s: Can't indent file\n", batch->paths[i]);
+    }
+    free(batch->paths[i]);
+  }
+  fprintf(stderr, "%d files: %d indented, %d unchanged, %d unmatched brackets, %d failed\n",
+          batch->count, tally[FileIndented], tally[FileUnchanged],
+          tally[FileUnmatched], tally[FileFailed]);
+  free(batch->paths);
+  free(batch->status);
+
+  if (tally[FileUnmatched]) {
+    return EXIT_UNSUCCESS;
+  }
+  return tally[FileFailed] ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+   Read a list of file names, one per line, from standard input into the given batch.
+   @param batch batch to add the files to.
+ */
+void readFileList(Batch *batch)
+{
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  while ((len = getline(&line, &cap, stdin)) != -1) {
+    if (len > 0 && line[len - 1] == '\n') {
+      line[--len] = '\0';
+    }
+    if (len > 0) {
+      addFile(batch, line);
+    }
+  }
+  free(line);
+}
+
+/**
+   Save the given checkpoint index to the file with the given name.
+   @param path name of the index file.
+   @param index checkpoints to save.
+   @return false if the file couldn't be written.
+ */
+bool writeIndex(char const *path, CheckpointIndex *index)
+{
+  FILE *fp = fopen(path, "wb");
+  if (!fp) {
+    return false;
+  }
+  fwrite(INDEX_MAGIC, 1, sizeof(INDEX_MAGIC) - 1, fp);
+  fwrite(&index->length, sizeof(index->length), 1, fp);
+  fwrite(&index->interval, sizeof(index->interval), 1, fp);
+  fwrite(&index->lexer, sizeof(index->lexer), 1, fp);
+  fwrite(&index->policy, sizeof(index->policy), 1, fp);
+  fwrite(&index->count, sizeof(index->count), 1, fp);
+  fwrite(index->list, sizeof(Checkpoint), index->count, fp);
+  bool ok = !ferror(fp);
+  return fclose(fp) == 0 && ok;
+}
+
+/**
+   Return true if the checkpoints loaded into an index could have been written by dent:
+   each one starts in a state the lexers have, at a depth that isn't negative, and at an offset
+   past the one before it that's still within the indented output.
+   @param index the loaded index.
+   @return false if the index can't be trusted.
+ */
+bool validIndex(CheckpointIndex const *index)
+{
+  long long last = -1;
+  for (int i = 0; i < index->count; i++) {
+    Checkpoint const *point = &index->list[i];
+    if ((point->state & ~CONTINUED_LINE) < 0 || (point->state & ~CONTINUED_LINE) >= STATE_COUNT
+        || point->depth < 0 || point->offset <= last || point->offset > index->length) {
+      return false;
+    }
+    last = point->offset;
+  }
+  return true;
+}
+
+/**
+   Load a checkpoint index from the file with the given name.
+   An index that's corrupt, or holds more checkpoints than the file has room for,
+   is turned down like a missing one, so the input is indented from scratch.
+   @param path name of the index file.
+   @param index filled in with the checkpoints.
+   @return false if the file couldn't be read or isn't a valid index.
+ */
+bool readIndex(char const *path, CheckpointIndex *index)
+{
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return false;
+  }
+  struct stat st;
+  char magic[sizeof(INDEX_MAGIC) - 1];
+  bool ok = fstat(fileno(fp), &st) == 0
+    && fread(magic, 1, sizeof(magic), fp) == sizeof(magic)
+    && memcmp(magic, INDEX_MAGIC, sizeof(magic)) == 0
+    && fread(&index->length, sizeof(index->length), 1, fp) == 1
+    && fread(&index->interval, sizeof(index->interval), 1, fp) == 1
+    && fread(&index->lexer, sizeof(index->lexer), 1, fp) == 1
+    && fread(&index->policy, sizeof(index->policy), 1, fp) == 1
+    && fread(&index->count, sizeof(index->count), 1, fp) == 1
+    && index->length >= 0 && index->interval > 0 && index->count >= 0
+    && (unsigned long long) index->count <= (st.st_size - ftell(fp)) / sizeof(Checkpoint);
+  if (ok) {
+    index->cap = index->count;
+    index->list = malloc((index->count + 1) * sizeof(Checkpoint));
+    ok = index->list
+      && fread(index->list, sizeof(Checkpoint), index->count, fp) == (size_t) index->count
+      && validIndex(index);
+    if (!ok) {
+      free(index->list);
+    }
+  }
+  fclose(fp);
+  return ok;
+}
+
+/**
+   Re-indent a file that was indented before, after the bytes from start up to end were changed.
+   Indenting restarts from the last checkpoint in the old index at or before the change,
+   and once it's past the change, it stops at the first line where the indentation state
+   matches a checkpoint of the old index again; from there on the file is the same as before,
+   so the rest of it is copied as it is.  The index is then rewritten for the new output.
+   This assumes the file was dent's output (plus the change) when the old index was written.
+   @param text contents of the changed file.
+   @param len number of bytes in the file.
+   @param start offset of the first changed byte in the file.
+   @param end offset just past the last changed byte in the file.
+   @param old the index saved with the file before it was changed.
+   @param indexPath name of the index file to rewrite.
+   @param lex state machine deciding which curly brackets count.
+   @param policy how lines are indented.
+   @return exit status for the program.
+ */
+int indentIncremental(char const *text, size_t len, size_t start, size_t end,
+                      CheckpointIndex *old, char const *indexPath, Lexer const *lex,
+                      Policy const *policy)
+{
+  long long delta = (long long) len - old->length;
+  end = end < start ? start : end > len ? len : end;
+  start = start > len ? len : start;
+
+  // Find the last checkpoint at or before the change.
+  int k = 0;
+  while (k < old->count && old->list[k].offset <= (long long) start) {
+    k++;
+  }
+
+  CheckpointIndex fresh = { 0, old->interval, old->lexer, old->policy, NULL, 0, 0 };
+  for (int i = 0; i < k; i++) {
+    addCheckpoint(&fresh, old->list[i].offset, old->list[i].depth, old->list[i].state);
+  }
+  size_t pos = 0;
+  Output out;
+  initOutput(&out, STDOUT_FILENO, true);
+  Indenter ind = { 0, LineStart, lex, policy, &out, &fresh, 0, false, '\n' };
+  if (k > 0) {
+    pos = old->list[k - 1].offset;
+    ind.depth = old->list[k - 1].depth;
+    ind.state = old->list[k - 1].state & ~CONTINUED_LINE;
+    ind.continued = old->list[k - 1].state & CONTINUED_LINE;
+  }
+
+  // Everything before the checkpoint is unchanged, and so is its indentation.
+  // The re-indenting runs to the end of a line, so the last line of the change is whole.
+  emit(&out, text, pos);
+  char const *newline = end < len ? memchr(text + end, '\n', len - end) : NULL;
+  end = newline ? newline - text + 1 : len;
+  bool ok = indentBlock(&ind, text + pos, end - pos);
+  pos = end;
+
+  // Keep going a line at a time until the state matches the old index again.
+  bool synced = false;
+  while (ok && pos < len) {
+    if (pos > 0 && text[pos - 1] == '\n') {
+      long long was = pos - delta;
+      while (k < old->count && old->list[k].offset < was) {
+        k++;
+      }
+      int state = ind.state | (ind.continued ? CONTINUED_LINE : 0);
+      if (k < old->count && old->list[k].offset == was && old->list[k].depth == ind.depth
+          && old->list[k].state == state) {
+        synced = true;
+        break;
+      }
+    }
+    char const *nl = memchr(text + pos, '\n', len - pos);
+    size_t next = nl ? nl - text + 1 : len;
+    ok = indentBlock(&ind, text + pos, next - pos);
+    pos = next;
+  }
+
+  if (synced) {
+    // The rest of the file, and its checkpoints, are just shifted by however much the change moved them.
+    long long shift = (long long) out.total - (long long) (pos - delta);
+    if (fresh.count > 0 && fresh.list[fresh.count - 1].offset == (long long) out.total) {
+      k++;
+    }
+    for (; k < old->count; k++) {
+      addCheckpoint(&fresh, old->list[k].offset + shift, old->list[k].depth, old->list[k].state);
+    }
+    emit(&out, text + pos, len - pos);
+  }
+  else if (ok && !finishIndent(&ind)) {
+    ok = false;
+  }
+
+  if (!ok) {
+    unmatched(&out);
+  }
+  fresh.length = out.total;
+  finishOut(&out);
+  freeOutput(&out);
+  if (!writeIndex(indexPath, &fresh)) {
+    perror(indexPath);
+    exit(EXIT_FAILURE);
+  }
+  free(fresh.list);
+  return EXIT_SUCCESS;
 }
 
 /**
    Starting point for the program,
-   it reads text from standard input until it reaches the end-of-file.
+   it reads text from standard input, or from the file named by its optional argument,
+   until it reaches the end-of-file.
    Discard spaces at the start of the line until it reaches a non-whitespace character.
    Prints out spaces to properly indent the line
    and prints the rest of the line exactly like it appears in the input.
@@ -50,92 +867,244 @@ bool isASpace(char ch)
    and lines containing only whitespaces.
    Handles the contents of double-quoted string literally.
    Handles invalid inputs where the input doesn't have matching opening and closing curly brackets.
+   A regular file is memory-mapped, and unchanged text is written straight from the mapping.
+   With -j, the input is indented by that many threads.
+   With -r, every C source file under a directory is indented,
+   and with -l the names of the files to indent are read from standard input.
+   These files are replaced in place, or written under the directory given with -o.
+   With -c, comments, character literals and backslash escapes are understood as in C.
+   The indentation policy is chosen with -w (columns for each level), -t (indent with tabs),
+   -k (extra columns for continued lines) and -s (pull case labels back a level).
+   With -x, a checkpoint index for the output is saved to the given file every -n lines,
+   and with -u start,end as well, only the part of the file affected by a change
+   to those bytes is re-indented, using the index that was saved before the change.
+   With -a, input that isn't memory-mapped is read and written on their own threads,
+   overlapped with indenting.
+   With -p, a profile of the input and the time spent reading, indenting and writing it
+   is printed to standard error.
+   @param argc the number of command-line arguments.
+   @param argv command-line arguments.
    @return exit status for the program.
  */
-int main()
+int main(int argc, char *argv[])
 {
-  int ch = getchar();
+  int threads = 0;
+  Batch batch = { NULL, 0, 0, NULL, NULL, NULL, &plainLexer, NULL };
+  DentOptions options;
+  dentDefaults(&options);
+  bool fileList = false;
+  char const *indexPath = NULL;
+  int interval = CHECKPOINT_LINES;
+  long long changeStart = -1, changeEnd = -1;
+  bool profiling = false;
+  bool pipelined = false;
+  bool usage = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "cw:tk:sj:r:lo:x:n:u:pa")) != -1) {
+    if (opt == 'c') {
+      options.cSyntax = true;
+    }
+    else if (opt == 'w' && atoi(optarg) >= 0 && atoi(optarg) <= MAX_WIDTH) {
+      options.width = atoi(optarg);
+    }
+    else if (opt == 't') {
+      options.tabs = true;
+    }
+    else if (opt == 'k' && atoi(optarg) >= 0 && atoi(optarg) <= MAX_WIDTH) {
+      options.continuation = atoi(optarg);
+    }
+    else if (opt == 's') {
+      options.outdentLabels = true;
+    }
+    else if (opt == 'j' && atoi(optarg) >= 1 && atoi(optarg) <= MAX_THREADS) {
+      threads = atoi(optarg);
+    }
+    else if (opt == 'r') {
+      batch.root = optarg;
+    }
+    else if (opt == 'l') {
+      fileList = true;
+    }
+    else if (opt == 'o') {
+      batch.outDir = optarg;
+    }
+    else if (opt == 'x') {
+      indexPath = optarg;
+    }
+    else if (opt == 'n' && atoi(optarg) >= 1) {
+      interval = atoi(optarg);
+    }
+    else if (opt == 'p') {
+      profiling = true;
+    }
+    else if (opt == 'a') {
+      pipelined = true;
+    }
+    else if (opt == 'u') {
+      if (sscanf(optarg, "%lld,%lld", &changeStart, &changeEnd) != 2
+          || changeStart < 0 || changeEnd < changeStart) {
+        usage = true;
+      }
+    }
+    else {
+      usage = true;
+    }
+  }
+  bool batchMode = batch.root || fileList;
+  bool incremental = changeStart >= 0;
+  if (usage || argc - optind > (batchMode ? 0 : 1) || (batch.outDir && !batchMode)
+      || (indexPath && (batchMode || threads > 1))
+      || (incremental && (!indexPath || optind == argc))
+      || ((profiling || pipelined) && (batchMode || incremental)) || (pipelined && threads > 1)) {
+    fprintf(stderr, "usage: dent [style] [-p] [-a | -j threads] [file]\n"
+            "       dent [style] [-j threads] (-r dir | -l) [-o outdir]\n"
+            "       dent [style] -x index [-n lines] [file]\n"
+            "       dent [style] -x index -u start,end file\n"
+            "style: [-c] [-w width] [-t] [-k continuation] [-s]\n");
+    exit(EXIT_FAILURE);
+  }
+  initDent();
+  Profile *profile = NULL;
+  if (profiling) {
+    profile = &report;
+    atexit(printReport);
+  }
+  static Policy policy;
+  initPolicy(&policy, options.width, options.tabs, options.continuation, options.outdentLabels);
+  batch.policy = &policy;
+  batch.lex = options.cSyntax ? &cLexer : &plainLexer;
+  Lexer const *lex = batch.lex;
 
-  // Handle the input line-by-line.
-  while (ch != EOF) {
+  if (batchMode) {
+    if (batch.root) {
+      walking = &batch;
+      if (nftw(batch.root, walkFile, WALK_FDS, FTW_PHYS | FTW_ACTIONRETVAL) != 0) {
+        perror(batch.root);
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (fileList) {
+      readFileList(&batch);
+    }
 
-    // Discard spaces at the start of the line until it reaches a non-whitespace character.
-    while (isASpace(ch)) {
-      ch = getchar();
+    // Use a worker for each processor unless told otherwise.
+    if (threads == 0) {
+      threads = sysconf(_SC_NPROCESSORS_ONLN);
+      threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
     }
+    return indentBatch(&batch, threads);
+  }
 
-    // Handle non-blank/blank line.
-    if (ch != '\n') {
-      // Handle line starting with }.
-      if (ch == '}') {
-        depth--;
-        // Handle the invalid input
-        // where the input has more closing curly brackets than open curly brackets.
-        if (depth < 0) {
-          printf("Unmatched brackets\n");
-          exit(EXIT_UNSUCCESS);
-        }
-      }
-      indent(depth);
-      if (ch == '{') {
-        depth++;
-      }
-      // Handles the contents of double-quoted string literally.
-      if (ch == '"') {
-        putchar(ch);
-        ch = getchar();
-        while (ch != '"' && ch != EOF) {
-          putchar(ch);
-          ch = getchar();
-        }
-        if (ch == EOF) {
-          return EXIT_SUCCESS;
-        }
-      }
-      putchar(ch);
-      ch = getchar();
-      while (ch != '\n') {
-        if (ch == '{') {
-          depth++;
-        }
-        if (ch == '}') {
-          depth--;
-          // Handle the invalid input
-          // where the input has more closing curly brackets than open curly brackets.
-          if (depth < 0) {
-            printf("Unmatched brackets\n");
-            exit(EXIT_UNSUCCESS);
-          }
-        }
-        // Handles the contents of double-quoted string literally.
-        if (ch == '"') {
-          putchar(ch);
-          ch = getchar();
-          while (ch != '"' && ch != EOF) {
-            putchar(ch);
-            ch = getchar();
-          }
-          if (ch == EOF) {
-            return EXIT_SUCCESS;
-          }
-        }
-        putchar(ch);
-        ch = getchar();
-      }
+  int fd = STDIN_FILENO;
+  if (optind < argc) {
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0) {
+      perror(argv[optind]);
+      exit(EXIT_FAILURE);
     }
+  }
 
-    // Put the last character('\n') at the end of the line
-    // and read the first character of the next line.
-    putchar(ch);
-    ch = getchar();
+  // Map a regular file, so its text can be written without copying it.
+  struct stat st;
+  char *text = NULL;
+  size_t len = 0;
+  bool mapped = false;
+  double start = profile ? profileClock() : 0;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text != MAP_FAILED) {
+      len = st.st_size;
+      mapped = true;
+      madvise(text, len, MADV_SEQUENTIAL);
+    }
+    else {
+      text = NULL;
+    }
   }
 
-  // Handle the invalid input
-  // where the input has more opening curly brackets than closing curly brackets.
-  if (depth > 0) {
-    printf("Unmatched brackets\n");
-    exit(EXIT_UNSUCCESS);
+  // With an index from before the change, only the part of the file the change affects is re-indented.
+  CheckpointIndex index = { 0, interval, lex->id, policy.id, NULL, 0, 0 };
+  if (incremental && mapped && readIndex(indexPath, &index)) {
+    if (index.lexer == lex->id && index.policy == policy.id) {
+      int status = indentIncremental(text, len, changeStart, changeEnd, &index, indexPath, lex,
+                                     &policy);
+      free(index.list);
+      return status;
+    }
+    free(index.list);
+  }
+  index.interval = interval;
+  index.lexer = lex->id;
+  index.policy = policy.id;
+  index.list = NULL;
+  index.count = index.cap = 0;
+
+  // The parallel mode needs all of the input at once.
+  if (threads > 1) {
+    if (!mapped) {
+      text = readAll(fd, &len);
+    }
+    if (profile) {
+      profile->readTime += profileClock() - start;
+    }
+    return indentParallel(text, len, threads, lex, &policy, profile);
   }
 
+  Output out;
+  Output *result = &out;
+  DentState *dent = NULL;
+  bool ok;
+  if (mapped) {
+    // Pages of the mapping are read in as they're first touched, which is counted as indenting.
+    if (profile) {
+      profile->readTime += profileClock() - start;
+    }
+    initOutput(&out, STDOUT_FILENO, true);
+    out.profile = profile;
+    Indenter ind = { 0, LineStart, lex, &policy, &out, indexPath ? &index : NULL, 0, false, '\n',
+                     profile };
+    ok = indentBlock(&ind, text, len) && finishIndent(&ind);
+    if (profile) {
+      finishProfile(profile);
+    }
+  }
+  else {
+    // Anything else is streamed through the library, a block at a time.
+    static int outFd = STDOUT_FILENO;
+    dent = dentCreate(&options, writeSink, &outFd);
+    if (!dent) {
+      perror("dent");
+      exit(EXIT_FAILURE);
+    }
+    dent->ind.index = indexPath ? &index : NULL;
+    dent->ind.profile = dent->out.profile = profile;
+    result = &dent->out;
+    DentStatus status = pipelined ? indentPipelined(dent, fd) : indentStream(dent, fd);
+    ok = status != DentUnmatched;
+  }
+
+  // Output may still point into the mapping, so it's written before the mapping goes away.
+  if (!ok) {
+    unmatched(result);
+  }
+  finishOut(result);
+  if (indexPath) {
+    index.length = result->total;
+    if (!writeIndex(indexPath, &index)) {
+      perror(indexPath);
+      exit(EXIT_FAILURE);
+    }
+    free(index.list);
+  }
+  if (dent) {
+    dentFree(dent);
+  }
+  else {
+    freeOutput(&out);
+  }
+  if (mapped) {
+    munmap(text, len);
+  }
+  close(fd);
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,685 @@
+/**
+   @file dentlib.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   The indenter at the heart of dent, as a library.  Output goes to a file descriptor,
+   a callback or memory, and problems are reported through return values instead of exiting,
+   so the dent program and other programs can both build on it.
+ */
+
+#include "dentlib.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/** Length of the runs of spaces and tabs indentation is copied from. */
+#define SPACE_RUN 4096
+
+/** Size of the buffer a partial line is first held back in. */
+#define READ_SIZE 65536
+
+/** Sixteen copies of a character, for building long runs of it. */
+#define RUN16(c) c c c c c c c c c c c c c c c c
+
+/** SPACE_RUN copies of a character, as a string literal. */
+#define RUN4096(c) RUN16(RUN16(RUN16(c)))
+
+/** A long run of spaces, so indentation can be copied instead of built a space at a time. */
+static char const spaces[SPACE_RUN + 1] = RUN4096(" ");
+
+/** A long run of tabs, for policies that indent with tabs. */
+static char const tabs[SPACE_RUN + 1] = RUN4096("\t");
+
+void initOutput(Output *out, int fd, bool zeroCopy)
+{
+  out->fd = fd;
+  out->sink = NULL;
+  out->context = NULL;
+  out->zeroCopy = zeroCopy;
+  out->len = 0;
+  out->cap = zeroCopy ? 0 : WRITE_SIZE;
+  out->data = zeroCopy ? NULL : malloc(out->cap);
+  out->count = 0;
+  out->pieceCap = zeroCopy ? IOV_BATCH : 0;
+  out->pieces = zeroCopy ? malloc(out->pieceCap * sizeof(struct iovec)) : NULL;
+  out->total = 0;
+  out->failed = false;
+  out->error = 0;
+  out->profile = NULL;
+}
+
+void initSinkOutput(Output *out, DentSink sink, void *context)
+{
+  initOutput(out, -1, false);
+  out->sink = sink;
+  out->context = context;
+}
+
+void freeOutput(Output *out)
+{
+  free(out->data);
+  free(out->pieces);
+}
+
+bool writeAll(int fd, char const *buf, size_t len)
+{
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool writePieces(int fd, struct iovec *iov, int count)
+{
+  while (count > 0) {
+    ssize_t n = writev(fd, iov, count < IOV_BATCH ? count : IOV_BATCH);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    // Skip the pieces that were written completely, and the front of a partial one.
+    while (count > 0 && (size_t) n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char *) iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return true;
+}
+
+/**
+   Hand the given bytes to the output's sink or write them to its file descriptor,
+   marking the output as failed if that doesn't work.
+   @param out output to write to.
+   @param buf bytes to write.
+   @param len number of bytes to write.
+ */
+static void deliver(Output *out, char const *buf, size_t len)
+{
+  if (out->failed) {
+    return;
+  }
+  errno = 0;
+  double start = out->profile ? profileClock() : 0;
+  bool ok = out->sink ? out->sink(out->context, buf, len) : writeAll(out->fd, buf, len);
+  if (out->profile) {
+    out->profile->writeTime += profileClock() - start;
+  }
+  if (!ok) {
+    out->failed = true;
+    out->error = errno;
+  }
+}
+
+bool flushOut(Output *out)
+{
+  if (out->zeroCopy) {
+    double start = out->profile ? profileClock() : 0;
+    if (!out->failed && !writePieces(out->fd, out->pieces, out->count)) {
+      out->failed = true;
+      out->error = errno;
+    }
+    if (out->profile) {
+      out->profile->writeTime += profileClock() - start;
+    }
+    out->count = 0;
+  }
+  else {
+    deliver(out, out->data, out->len);
+    out->len = 0;
+  }
+  return !out->failed;
+}
+
+void emit(Output *out, char const *buf, size_t len)
+{
+  out->total += len;
+  if (out->zeroCopy) {
+    if (out->count > 0) {
+      struct iovec *last = &out->pieces[out->count - 1];
+      if ((char const *) last->iov_base + last->iov_len == buf) {
+        last->iov_len += len;
+        return;
+      }
+    }
+    if (out->count == out->pieceCap) {
+      if (out->fd >= 0) {
+        flushOut(out);
+      }
+      else {
+        out->pieceCap *= 2;
+        out->pieces = realloc(out->pieces, out->pieceCap * sizeof(struct iovec));
+      }
+    }
+    out->pieces[out->count].iov_base = (void *) buf;
+    out->pieces[out->count].iov_len = len;
+    out->count++;
+    return;
+  }
+
+  if (out->len + len > out->cap) {
+    if (out->fd >= 0 || out->sink) {
+      flushOut(out);
+      if (len >= out->cap) {
+        deliver(out, buf, len);
+        return;
+      }
+    }
+    else {
+      while (out->len + len > out->cap) {
+        out->cap *= 2;
+      }
+      out->data = realloc(out->data, out->cap);
+    }
+  }
+  memcpy(out->data + out->len, buf, len);
+  out->len += len;
+}
+
+/**
+   Add n copies of a character to the output from a run of them.
+   @param out output to add to.
+   @param run run of SPACE_RUN copies of the character.
+   @param n number of copies to add.
+ */
+static void emitRun(Output *out, char const *run, size_t n)
+{
+  while (n > SPACE_RUN) {
+    emit(out, run, SPACE_RUN);
+    n -= SPACE_RUN;
+  }
+  emit(out, run, n);
+}
+
+/**
+   Print out tabs and spaces to properly indent the start of a line to an indentation depth of d,
+   as the given policy says for a line of the given kind.
+   @param out output to add the indentation to.
+   @param policy how lines are indented.
+   @param kind kind of the line.
+   @param d the indentation depth.
+ */
+static void indent(Output *out, Policy const *policy, LineKind kind, int d)
+{
+  Prefix prefix = d < PREFIX_DEPTH ? policy->prefix[kind][d] : makePrefix(policy, kind, d);
+  if (prefix.tabs) {
+    emitRun(out, tabs, prefix.tabs);
+  }
+  emitRun(out, spaces, prefix.spaces);
+}
+
+void addCheckpoint(CheckpointIndex *index, long long offset, int depth, int state)
+{
+  if (index->count == index->cap) {
+    index->cap = index->cap ? index->cap * 2 : IOV_BATCH;
+    index->list = realloc(index->list, index->cap * sizeof(Checkpoint));
+  }
+  Checkpoint *cp = &index->list[index->count++];
+  cp->offset = offset;
+  cp->depth = depth;
+  cp->state = state;
+}
+
+/**
+   Count a line that was just finished in the output,
+   recording a checkpoint for the line after it if it's time for one.
+   @param ind indentation state, with a place to record checkpoints.
+   @param offset offset in the output of the start of the next line.
+ */
+static void noteLine(Indenter *ind, size_t offset)
+{
+  if (++ind->lines >= ind->index->interval) {
+    addCheckpoint(ind->index, offset, ind->depth,
+                  ind->state | (ind->continued ? CONTINUED_LINE : 0));
+    ind->lines = 0;
+  }
+}
+
+/**
+   Return true if the given ch is either a space or a tab character.
+   @param ch the character to check.
+   @return true if the given ch is either a space or a tab character.
+ */
+static bool isASpace(char ch)
+{
+  return ch == ' ' || ch == '\t';
+}
+
+/**
+   Return the last character before the given end of the text that isn't a space or a tab.
+   @param text text to look back through.
+   @param end offset to look back from.
+   @param before character to return if there's nothing but spaces and tabs before end.
+   @return the last character before end that isn't a space or a tab.
+ */
+static char lastMark(char const *text, size_t end, char before)
+{
+  while (end > 0 && isASpace(text[end - 1])) {
+    end--;
+  }
+  return end > 0 ? text[end - 1] : before;
+}
+
+void resumeAt(Indenter *ind, char const *text, size_t pos)
+{
+  ind->tail = lastMark(text, pos, '\n');
+  ind->continued = pos > 0 && ind->policy->continues[(unsigned char) lastMark(text, pos - 1, '\n')];
+}
+
+/**
+   Indent one block of input, continuing from whatever state the previous block left behind.
+   Outside of the start of a line, the scanner skips straight to the next character
+   that matters in its current state and copies the text before it as one run,
+   then follows the lexer's table for that character.
+   This is specialized for each combination of the policy features that need to look at lines,
+   and for profiling, so the indenting for policies without them doesn't check for them at all.
+   Return false, with everything before the offending bracket in the output,
+   if there are more closing curly brackets than open curly brackets.
+   @param ind indentation state, updated for the end of the block.
+   @param buf block of input.
+   @param len number of bytes in the block.
+   @param labels true if case and default labels are indented differently.
+   @param continuation true if continued lines are indented differently.
+   @param profiled true if blank lines, depths and literal text are counted in the profile.
+   @return false if there's an unmatched closing curly bracket.
+ */
+static inline __attribute__((always_inline))
+bool indentBlockAs(Indenter *ind, char const *buf, size_t len, bool labels, bool continuation,
+                   bool profiled)
+{
+  Output *out = ind->out;
+  Lexer const *lex = ind->lex;
+  Policy const *policy = ind->policy;
+  Profile *prof = ind->profile;
+  ScanCache cache = { NULL, NULL, 0 };
+  size_t i = 0;
+  while (i < len) {
+    if (ind->state == LineStart) {
+      // Discard spaces at the start of the line until it reaches a non-whitespace character.
+      while (i < len && isASpace(buf[i])) {
+        i++;
+      }
+      if (i == len) {
+        return true;
+      }
+
+      // Blank lines don't get indented.
+      if (buf[i] == '\n') {
+        emit(out, buf + i, 1);
+        i++;
+        if (profiled) {
+          prof->blank++;
+        }
+        if (continuation) {
+          ind->continued = false;
+        }
+        if (ind->index) {
+          noteLine(ind, out->total);
+        }
+        continue;
+      }
+
+      // Handle line starting with }.
+      if (buf[i] == '}') {
+        ind->depth--;
+        if (ind->depth < 0) {
+          return false;
+        }
+        indent(out, policy, LineNormal, ind->depth);
+        emit(out, buf + i, 1);
+        i++;
+      }
+      else {
+        LineKind kind = LineNormal;
+        if (continuation && ind->continued) {
+          kind = LineContinued;
+        }
+        if (labels && isLabel(buf + i, len - i)) {
+          kind = LineLabel;
+        }
+        indent(out, policy, kind, ind->depth);
+      }
+      if (profiled) {
+        prof->indented++;
+        prof->depthSum += ind->depth;
+        if (ind->depth > prof->maxDepth) {
+          prof->maxDepth = ind->depth;
+        }
+      }
+      ind->state = InLine;
+    }
+    else {
+      // Follow the table in locals, so copying the text doesn't force the state to be reloaded.
+      int state = ind->state;
+      int depth = ind->depth;
+      size_t j = i;
+      while (state != LineStart) {
+        ScanSet const *stops = lex->stops[state];
+        j = stops ? i + findNext(&cache, buf + i, len - i, stops) : i;
+        if (j == len) {
+          break;
+        }
+        Transition t = lex->table[state][lex->classOf[(unsigned char) buf[j]]];
+        depth += t.delta;
+        // Handle the invalid input
+        // where the input has more closing curly brackets than open curly brackets.
+        if (depth < 0) {
+          break;
+        }
+        if (profiled) {
+          if (lex->literal[state]) {
+            prof->literalBytes += j - i;
+          }
+          if (depth > prof->maxDepth) {
+            prof->maxDepth = depth;
+          }
+        }
+        state = t.next;
+        emit(out, buf + i, j + 1 - i);
+        i = j + 1;
+        if (continuation && buf[j] == '\n') {
+          ind->continued = policy->continues[(unsigned char) lastMark(buf, j, ind->tail)];
+        }
+        if (ind->index && buf[j] == '\n') {
+          ind->state = state;
+          ind->depth = depth;
+          noteLine(ind, out->total);
+        }
+      }
+      ind->state = state;
+      ind->depth = depth;
+      if (j == len) {
+        if (profiled && lex->literal[state]) {
+          prof->literalBytes += len - i;
+        }
+        emit(out, buf + i, len - i);
+        return true;
+      }
+      if (depth < 0) {
+        emit(out, buf + i, j - i);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+   Indent one block of input for a policy that indents every line by its depth alone.
+   @param ind indentation state, updated for the end of the block.
+   @param buf block of input.
+   @param len number of bytes in the block.
+   @return false if there's an unmatched closing curly bracket.
+ */
+static bool indentBlockPlain(Indenter *ind, char const *buf, size_t len)
+{
+  return indentBlockAs(ind, buf, len, false, false, false);
+}
+
+/**
+   Indent one block of input for a policy that pulls back case labels.
+   @param ind indentation state, updated for the end of the block.
+   @param buf block of input.
+   @param len number of bytes in the block.
+   @return false if there's an unmatched closing curly bracket.
+ */
+static bool indentBlockLabels(Indenter *ind, char const *buf, size_t len)
+{
+  return indentBlockAs(ind, buf, len, true, false, false);
+}
+
+/**
+   Indent one block of input for a policy with a continuation indent.
+   @param ind indentation state, updated for the end of the block.
+   @param buf block of input.
+   @param len number of bytes in the block.
+   @return false if there's an unmatched closing curly bracket.
+ */
+static bool indentBlockContinued(Indenter *ind, char const *buf, size_t len)
+{
+  return indentBlockAs(ind, buf, len, false, true, false);
+}
+
+/**
+   Indent one block of input for a policy that pulls back case labels
+   and has a continuation indent.
+   @param ind indentation state, updated for the end of the block.
+   @param buf block of input.
+   @param len number of bytes in the block.
+   @return false if there's an unmatched closing curly bracket.
+ */
+static bool indentBlockBoth(Indenter *ind, char const *buf, size_t len)
+{
+  return indentBlockAs(ind, buf, len, true, true, false);
+}
+
+/**
+   Indent one block of input for any policy, counting what it finds in the indenter's profile.
+   @param ind indentation state, updated for the end of the block.
+   @param buf block of input.
+   @param len number of bytes in the block.
+   @return false if there's an unmatched closing curly bracket.
+ */
+static bool indentBlockProfiled(Indenter *ind, char const *buf, size_t len)
+{
+  return indentBlockAs(ind, buf, len, ind->policy->outdentLabels, ind->policy->continuation > 0,
+                       true);
+}
+
+/**
+   Count the lines ending in the given block of input in the profile, and the block's bytes.
+   @param profile profile to count the lines in.
+   @param buf block of input.
+   @param len number of bytes in the block.
+ */
+static void countLines(Profile *profile, char const *buf, size_t len)
+{
+  char const *newline = buf;
+  while ((newline = memchr(newline, '\n', buf + len - newline))) {
+    long long end = profile->bytes + (newline - buf);
+    countLength(profile, end - profile->lineBegin);
+    profile->lineBegin = end + 1;
+    newline++;
+  }
+  profile->bytes += len;
+}
+
+bool indentBlock(Indenter *ind, char const *buf, size_t len)
+{
+  Policy const *policy = ind->policy;
+  if (ind->profile) {
+    // Time spent writing output along the way isn't counted as scanning.
+    Profile *prof = ind->profile;
+    double start = profileClock();
+    double writing = prof->writeTime;
+    bool ok = indentBlockProfiled(ind, buf, len);
+    prof->scanTime += profileClock() - start - (prof->writeTime - writing);
+    if (policy->continuation) {
+      ind->tail = lastMark(buf, len, ind->tail);
+    }
+    countLines(prof, buf, len);
+    return ok;
+  }
+  if (!policy->continuation) {
+    return policy->outdentLabels ? indentBlockLabels(ind, buf, len)
+      : indentBlockPlain(ind, buf, len);
+  }
+  bool ok = policy->outdentLabels ? indentBlockBoth(ind, buf, len)
+    : indentBlockContinued(ind, buf, len);
+  ind->tail = lastMark(buf, len, ind->tail);
+  return ok;
+}
+
+bool finishIndent(Indenter *ind)
+{
+  return ind->lex->literal[ind->state] || ind->depth == 0;
+}
+
+/**
+   Set up the tables shared by every indenter.
+ */
+static void setUp()
+{
+  chooseScanner();
+  initLexers();
+}
+
+void initDent()
+{
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, setUp);
+}
+
+void dentDefaults(DentOptions *options)
+{
+  options->cSyntax = false;
+  options->width = DEFAULT_WIDTH;
+  options->tabs = false;
+  options->continuation = 0;
+  options->outdentLabels = false;
+  options->profile = false;
+}
+
+DentState *dentCreate(DentOptions const *options, DentSink sink, void *context)
+{
+  DentOptions defaults;
+  if (!options) {
+    dentDefaults(&defaults);
+    options = &defaults;
+  }
+  initDent();
+
+  DentState *state = malloc(sizeof(DentState));
+  if (!state) {
+    return NULL;
+  }
+  initPolicy(&state->policy, options->width, options->tabs, options->continuation,
+             options->outdentLabels);
+  initSinkOutput(&state->out, sink, context);
+  Indenter ind = { 0, LineStart, options->cSyntax ? &cLexer : &plainLexer, &state->policy,
+                   &state->out, NULL, 0, false, '\n', NULL };
+  state->ind = ind;
+  initProfile(&state->profile);
+  if (options->profile) {
+    state->ind.profile = &state->profile;
+    state->out.profile = &state->profile;
+  }
+  state->held = NULL;
+  state->heldLen = state->heldCap = 0;
+  state->status = DentOk;
+  return state;
+}
+
+/**
+   Hold the given text back until the rest of its line comes along.
+   @param state state to hold the text in.
+   @param buf text to hold back.
+   @param len number of bytes of text.
+ */
+static void holdBack(DentState *state, char const *buf, size_t len)
+{
+  if (state->heldLen + len > state->heldCap) {
+    state->heldCap = state->heldCap ? state->heldCap : READ_SIZE;
+    while (state->heldLen + len > state->heldCap) {
+      state->heldCap *= 2;
+    }
+    state->held = realloc(state->held, state->heldCap);
+  }
+  memcpy(state->held + state->heldLen, buf, len);
+  state->heldLen += len;
+}
+
+/**
+   Indent the given text with the given state, noting if it has an unmatched bracket.
+   @param state state to indent with.
+   @param buf text to indent.
+   @param len number of bytes of text.
+ */
+static void feedBlock(DentState *state, char const *buf, size_t len)
+{
+  if (state->status == DentOk && !indentBlock(&state->ind, buf, len)) {
+    state->status = DentUnmatched;
+  }
+}
+
+DentStatus dentFeed(DentState *state, char const *buf, size_t len)
+{
+  if (state->status != DentOk) {
+    return state->status;
+  }
+
+  if (!state->policy.outdentLabels) {
+    feedBlock(state, buf, len);
+  }
+  else {
+    // Only whole lines are indented; the end of the last one waits for the rest of it.
+    char const *last = memrchr(buf, '\n', len);
+    if (!last) {
+      holdBack(state, buf, len);
+      return state->status;
+    }
+    size_t done = last - buf + 1;
+    size_t start = 0;
+    if (state->heldLen) {
+      start = (char const *) memchr(buf, '\n', len) - buf + 1;
+      holdBack(state, buf, start);
+      feedBlock(state, state->held, state->heldLen);
+      state->heldLen = 0;
+    }
+    feedBlock(state, buf + start, done - start);
+    holdBack(state, buf + done, len - done);
+  }
+
+  // Everything up to an unmatched bracket is handed over, and nothing after it.
+  if (state->status == DentUnmatched || state->out.failed) {
+    flushOut(&state->out);
+  }
+  if (state->out.failed) {
+    state->status = DentFailed;
+  }
+  return state->status;
+}
+
+DentStatus dentFinish(DentState *state)
+{
+  if (state->status == DentOk) {
+    feedBlock(state, state->held, state->heldLen);
+    state->heldLen = 0;
+    if (state->status == DentOk && !finishIndent(&state->ind)) {
+      state->status = DentUnmatched;
+    }
+  }
+  if (state->ind.profile) {
+    finishProfile(state->ind.profile);
+  }
+  if (!flushOut(&state->out)) {
+    state->status = DentFailed;
+  }
+  return state->status;
+}
+
+void dentFree(DentState *state)
+{
+  if (state) {
+    freeOutput(&state->out);
+    free(state->held);
+    free(state);
+  }
+}
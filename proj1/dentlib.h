@@ -0,0 +1,355 @@
+/**
+   @file dentlib.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the dentlib.c component, the indenter at the heart of dent as a library.
+   It has the pieces the dent program puts together for its different modes, and a streaming
+   interface for indenting text in-process: make a DentState with a callback for the output,
+   feed it text a block at a time, then finish it.  Nothing in the library exits the program
+   or keeps per-text state in globals, so files can be indented on several threads at once.
+ */
+
+#ifndef _DENTLIB_H_
+#define _DENTLIB_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+#include "lex.h"
+#include "policy.h"
+#include "profile.h"
+
+/** Number of bytes collected in the output buffer before it's written out. */
+#define WRITE_SIZE 65536
+
+/** Number of output pieces collected before they're handed to writev() together. */
+#define IOV_BATCH 1024
+
+/** Flag added to the state saved in a checkpoint when the line is a continued one. */
+#define CONTINUED_LINE 0x100
+
+/**
+   Callback that indented output is handed to, a block at a time.
+   @param context the pointer given along with the callback.
+   @param buf block of output.
+   @param len number of bytes in the block.
+   @return false if the output couldn't be written.
+ */
+typedef bool (*DentSink)(void *context, char const *buf, size_t len);
+
+/** Destination for indented output. */
+typedef struct {
+  /** File descriptor output is flushed to, or -1 to keep all of it in memory. */
+  int fd;
+
+  /** Callback output is flushed to instead of a file descriptor, or NULL, and its context. */
+  DentSink sink;
+  void *context;
+
+  /**
+     True if output is kept as pieces pointing at text that stays put (a memory-mapped input
+     and the run of spaces) instead of being copied into data.
+   */
+  bool zeroCopy;
+
+  /** Copied output, its length and its capacity. */
+  char *data;
+  size_t len;
+  size_t cap;
+
+  /** Output pieces, how many there are and how many there's room for. */
+  struct iovec *pieces;
+  int count;
+  int pieceCap;
+
+  /** Total number of bytes ever added to this output. */
+  size_t total;
+
+  /** True once some output couldn't be written, and the errno value it failed with. */
+  bool failed;
+  int error;
+
+  /** Profile the time spent writing is added to, or NULL if it isn't being timed. */
+  Profile *profile;
+} Output;
+
+/** Indentation state at the start of a line, so indenting can be restarted from there. */
+typedef struct {
+  /** Offset of the start of the line in the indented output. */
+  long long offset;
+
+  /** Level of indentation at the start of the line. */
+  int depth;
+
+  /**
+     State the line starts in, LineStart or inside a string or comment,
+     plus CONTINUED_LINE if the line continues the one before it.
+   */
+  int state;
+} Checkpoint;
+
+/** Checkpoints for a whole file, as saved in a sidecar index file. */
+typedef struct {
+  /** Length of the indented output the checkpoints describe. */
+  long long length;
+
+  /** Number of lines between checkpoints. */
+  int interval;
+
+  /** Id of the lexer the checkpoints were recorded with. */
+  int lexer;
+
+  /** Id of the indentation policy the checkpoints were recorded with. */
+  int policy;
+
+  /** The checkpoints in order, how many there are and how many there's room for. */
+  Checkpoint *list;
+  int count;
+  int cap;
+} CheckpointIndex;
+
+/** Everything needed to carry indentation from one block of input to the next. */
+typedef struct {
+  /** Level of indentation. */
+  int depth;
+
+  /** State the scanner is in between one block and the next. */
+  ScanState state;
+
+  /** State machine deciding which curly brackets count. */
+  Lexer const *lex;
+
+  /** How lines are indented. */
+  Policy const *policy;
+
+  /** Where the indented text goes. */
+  Output *out;
+
+  /** Where checkpoints are recorded, or NULL if they aren't. */
+  CheckpointIndex *index;
+
+  /** Number of lines since the last checkpoint. */
+  int lines;
+
+  /** True if the next line continues the last one, for policies with a continuation indent. */
+  bool continued;
+
+  /** Last character before the current block that isn't a space or tab. */
+  char tail;
+
+  /** Where the input is profiled, or NULL if it isn't. */
+  Profile *profile;
+} Indenter;
+
+
+/** How indenting the text fed to a DentState has turned out so far. */
+typedef enum {
+  /** Everything is fine so far. */
+  DentOk,
+
+  /** The text has unmatched curly brackets; the output stops just before the first problem. */
+  DentUnmatched,
+
+  /** Output couldn't be written, because the sink returned false. */
+  DentFailed
+} DentStatus;
+
+/** Choices for how a DentState indents text, matching dent's command-line options. */
+typedef struct {
+  /** True to understand comments, character literals and escapes as in C. */
+  bool cSyntax;
+
+  /** Number of columns for each level of indentation. */
+  int width;
+
+  /** True to indent with tabs as far as possible. */
+  bool tabs;
+
+  /** Extra columns for a continued line. */
+  int continuation;
+
+  /** True to pull case and default labels back one level. */
+  bool outdentLabels;
+
+  /** True to keep a profile of the text and the time spent on it. */
+  bool profile;
+} DentOptions;
+
+/**
+   Everything needed to indent one stream of text in-process.
+   Each state is independent, so different threads can use different states at once.
+ */
+typedef struct {
+  /** How lines are indented. */
+  Policy policy;
+
+  /** Output, flushed to the state's sink. */
+  Output out;
+
+  /** Indentation state between one block of text and the next. */
+  Indenter ind;
+
+  /** End of the text fed so far that's held back until its line is finished, if the policy needs whole lines. */
+  char *held;
+  size_t heldLen;
+  size_t heldCap;
+
+  /** How things have turned out so far. */
+  DentStatus status;
+
+  /** Profile of the text fed so far, if the options asked for one. */
+  Profile profile;
+} DentState;
+
+/**
+   Prepare the given output to write to the given file descriptor.
+   @param out output to initialize.
+   @param fd file descriptor to write to, or -1 to keep all the output in memory.
+   @param zeroCopy true to keep pointers to the output text instead of copying it.
+ */
+void initOutput(Output *out, int fd, bool zeroCopy);
+
+/**
+   Prepare the given output to copy output into a buffer that's handed to a callback as it fills.
+   @param out output to initialize.
+   @param sink callback to hand blocks of output to.
+   @param context pointer passed along to the sink.
+ */
+void initSinkOutput(Output *out, DentSink sink, void *context);
+
+/**
+   Free the memory used by the given output.
+   @param out output to free.
+ */
+void freeOutput(Output *out);
+
+/**
+   Write all of the given bytes to the given file descriptor,
+   retrying after short writes and interrupted system calls.
+   @param fd file descriptor to write to.
+   @param buf bytes to write.
+   @param len number of bytes to write.
+   @return false, with errno set, if the bytes couldn't be written.
+ */
+bool writeAll(int fd, char const *buf, size_t len);
+
+/**
+   Write all of the given pieces to the given file descriptor, at most IOV_BATCH at a time,
+   retrying after short writes and interrupted system calls.
+   The pieces are updated in place as they're written.
+   @param fd file descriptor to write to.
+   @param iov pieces of output to write.
+   @param count number of pieces.
+   @return false, with errno set, if the pieces couldn't be written.
+ */
+bool writePieces(int fd, struct iovec *iov, int count);
+
+/**
+   Write everything waiting in the given output to its file descriptor or sink and empty it.
+   If that fails, the output is marked as failed, and anything added to it later is thrown away.
+   @param out output to flush.
+   @return false if the output has failed.
+ */
+bool flushOut(Output *out);
+
+/**
+   Add the given bytes to the output.  Normally they're copied to the output buffer,
+   which is flushed as it fills, and runs too long to be worth copying are written straight through.
+   For zero-copy output, the bytes stay where they are and only a pointer to them is kept;
+   a piece that continues right where the previous one ended just extends it.
+   Output that's kept in memory grows as needed instead of being flushed.
+   A failure to write is noted in the output, for flushOut() to report.
+   @param out output to add to.
+   @param buf bytes to append.  For zero-copy output,
+   these must stay valid until the output is flushed.
+   @param len number of bytes to append.
+ */
+void emit(Output *out, char const *buf, size_t len);
+
+/**
+   Add the given checkpoint to the end of the given index.
+   @param index index to add to.
+   @param offset offset of the start of the line in the output.
+   @param depth level of indentation at the start of the line.
+   @param state state the line starts in.
+ */
+void addCheckpoint(CheckpointIndex *index, long long offset, int depth, int state);
+
+/**
+   Set up the given indentation state for carrying on at the start of a line in the given text,
+   working out from the text before it whether that line is a continued one.
+   @param ind indentation state to set up.
+   @param text the whole text.
+   @param pos offset of the start of a line in the text.
+ */
+void resumeAt(Indenter *ind, char const *text, size_t pos);
+
+/**
+   Indent one block of input, continuing from whatever state the previous block left behind,
+   with the version of the indenter specialized for the policy.
+   Policies that pull back case labels need every line to be whole in one block.
+   If the indenter has a profile, a version that also counts lines and times itself is used.
+   @param ind indentation state, updated for the end of the block.
+   @param buf block of input.
+   @param len number of bytes in the block.
+   @return false if there's an unmatched closing curly bracket.
+ */
+bool indentBlock(Indenter *ind, char const *buf, size_t len);
+
+/**
+   Return true if the input indented so far can end here.
+   An input that ends inside a string (or a character literal or block comment)
+   isn't considered an error, but otherwise every opening curly bracket needs a closing one.
+   @param ind indentation state at the end of the input.
+   @return false if there are unmatched opening curly brackets.
+ */
+bool finishIndent(Indenter *ind);
+
+/**
+   Set up the tables shared by every indenter, the scanning kernel and the lexers.
+   This only does anything the first time it's called, and it's safe to call from any thread.
+ */
+void initDent();
+
+/**
+   Fill in the given options with dent's defaults: the plain lexer and two-space indentation.
+   @param options options to fill in.
+ */
+void dentDefaults(DentOptions *options);
+
+/**
+   Make a new state for indenting a stream of text, sending the output to the given sink.
+   @param options how to indent the text, or NULL for the defaults.
+   @param sink callback to hand blocks of output to.
+   @param context pointer passed along to the sink.
+   @return the new state, to be freed with dentFree(), or NULL if there's no memory for it.
+ */
+DentState *dentCreate(DentOptions const *options, DentSink sink, void *context);
+
+/**
+   Indent the next block of text.  The block can end anywhere, even in the middle of a line.
+   Output is handed to the sink as it builds up, and the rest when the state is finished.
+   Once something goes wrong, the rest of the text is ignored.
+   @param state state to feed the text to.
+   @param buf block of text.
+   @param len number of bytes in the block.
+   @return how things have turned out so far.
+ */
+DentStatus dentFeed(DentState *state, char const *buf, size_t len);
+
+/**
+   Finish indenting, at the end of the text, and hand the rest of the output to the sink.
+   Text that ends with unmatched opening curly brackets is reported here.
+   No message is written to the output; the caller decides what to do about unmatched brackets.
+   @param state state to finish.
+   @return how indenting the text turned out.
+ */
+DentStatus dentFinish(DentState *state);
+
+/**
+   Free the given state.
+   @param state state to free.
+ */
+void dentFree(DentState *state);
+
+#endif
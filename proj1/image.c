@@ -0,0 +1,487 @@
+/**
+   @file image.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Binary PPM and PNG files laid out in one buffer.  In a PNG file, each row is its own zlib
+   stored block (or a few, for rows too long for one), so rows have fixed places in the file and
+   can be painted in any order.  Each band of rows is an IDAT chunk, whose CRC can be worked out
+   as soon as the band is done, along with the Adler-32 checksum of its rows.  Those are combined
+   at the end into the checksum for the whole zlib stream, which goes in the last chunk.
+   A file can also be streamed out a band at a time, with the same bytes, so only one band
+   of it is ever in memory.
+ */
+
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Largest number of bytes in a zlib stored block. */
+#define STORED_MAX 65535
+
+/** Number of bytes in the header of a zlib stored block. */
+#define STORED_HEADER 5
+
+/** Largest number of bytes of data put in one PNG chunk. */
+#define CHUNK_MAX (1 << 30)
+
+/** Number of bytes a PNG chunk adds around its data: the length, the type and the CRC. */
+#define CHUNK_EXTRA 12
+
+/** Number of bytes in the PNG signature and the IHDR chunk that follows it. */
+#define PNG_HEAD (8 + CHUNK_EXTRA + 13)
+
+/** Number of bytes in the zlib header, and in the Adler-32 checksum at the end of the stream. */
+#define ZLIB_HEADER 2
+#define ZLIB_TRAILER 4
+
+/** Modulus for the Adler-32 checksum, and how many bytes can be added up before reducing. */
+#define ADLER_MOD 65521
+#define ADLER_RUN 5552
+
+/** Number of bytes the CRC-32 is worked out for at a time. */
+#define CRC_SLICE 8
+
+/**
+   Tables for working out CRC-32 eight bytes at a time, filled in the first time they're needed.
+   Table k gives the effect of a byte followed by k zero bytes.
+ */
+static uint32_t crcTable[CRC_SLICE][256];
+
+/**
+   Fill in the CRC-32 tables, if they haven't been already.
+ */
+static void initCRC()
+{
+  if (crcTable[0][1]) {
+    return;
+  }
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++) {
+      c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    }
+    crcTable[0][n] = c;
+  }
+  for (int k = 1; k < CRC_SLICE; k++) {
+    for (int n = 0; n < 256; n++) {
+      uint32_t c = crcTable[k - 1][n];
+      crcTable[k][n] = crcTable[0][c & 0xFF] ^ (c >> 8);
+    }
+  }
+}
+
+/**
+   Return the CRC-32 of the given bytes.
+   @param buf bytes to check.
+   @param len number of bytes.
+   @return the checksum.
+ */
+static uint32_t crc32(unsigned char const *buf, size_t len)
+{
+  uint32_t c = 0xFFFFFFFF;
+  while (len >= CRC_SLICE) {
+    uint32_t low = c ^ (buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t) buf[3] << 24);
+    c = crcTable[7][low & 0xFF] ^ crcTable[6][low >> 8 & 0xFF]
+      ^ crcTable[5][low >> 16 & 0xFF] ^ crcTable[4][low >> 24]
+      ^ crcTable[3][buf[4]] ^ crcTable[2][buf[5]] ^ crcTable[1][buf[6]] ^ crcTable[0][buf[7]];
+    buf += CRC_SLICE;
+    len -= CRC_SLICE;
+  }
+  while (len-- > 0) {
+    c = crcTable[0][(c ^ *buf++) & 0xFF] ^ (c >> 8);
+  }
+  return c ^ 0xFFFFFFFF;
+}
+
+/**
+   Add the given bytes to an Adler-32 checksum.
+   @param adler checksum so far, 1 to start with.
+   @param buf bytes to add.
+   @param len number of bytes.
+   @return the updated checksum.
+ */
+static uint32_t adler32(uint32_t adler, unsigned char const *buf, size_t len)
+{
+  uint32_t a = adler & 0xFFFF;
+  uint32_t b = adler >> 16;
+  while (len > 0) {
+    size_t n = len < ADLER_RUN ? len : ADLER_RUN;
+    len -= n;
+    while (n-- > 0) {
+      a += *buf++;
+      b += a;
+    }
+    a %= ADLER_MOD;
+    b %= ADLER_MOD;
+  }
+  return b << 16 | a;
+}
+
+/**
+   Combine the Adler-32 checksums of two runs of bytes into the checksum of one after the other.
+   @param first checksum of the first run.
+   @param second checksum of the second run.
+   @param len number of bytes in the second run.
+   @return checksum of both runs.
+ */
+static uint32_t combineAdler(uint32_t first, uint32_t second, size_t len)
+{
+  uint64_t rem = len % ADLER_MOD;
+  uint64_t a = (first & 0xFFFF) + (second & 0xFFFF) + ADLER_MOD - 1;
+  uint64_t b = rem * (first & 0xFFFF) % ADLER_MOD
+    + (first >> 16) + (second >> 16) + ADLER_MOD - rem;
+  return (uint32_t) (b % ADLER_MOD) << 16 | (uint32_t) (a % ADLER_MOD);
+}
+
+/**
+   Store a 32-bit number with its most significant byte first, as PNG and zlib do.
+   @param p place to store it.
+   @param n number to store.
+ */
+static void putBig(unsigned char *p, uint32_t n)
+{
+  p[0] = n >> 24;
+  p[1] = n >> 16;
+  p[2] = n >> 8;
+  p[3] = n;
+}
+
+/**
+   Return the number of bytes of data in the given IDAT chunk of a PNG image.
+   @param image the image.
+   @param c index of the chunk.
+   @return the length of the chunk's data.
+ */
+static size_t chunkData(Image const *image, int c)
+{
+  int rows = image->size - c * image->bandRows;
+  rows = rows < image->bandRows ? rows : image->bandRows;
+  size_t len = rows * image->stride;
+  if (c == 0) {
+    len += ZLIB_HEADER;
+  }
+  if (c == image->bands - 1) {
+    len += ZLIB_TRAILER;
+  }
+  return len;
+}
+
+/**
+   Write a chunk's length and type at the given place.
+   @param p start of the chunk.
+   @param len length of the chunk's data.
+   @param type the chunk's four-letter type.
+ */
+static void startChunk(unsigned char *p, size_t len, char const *type)
+{
+  putBig(p, len);
+  memcpy(p + 4, type, 4);
+}
+
+/**
+   Write the CRC at the end of a chunk, covering its type and data.
+   @param p start of the chunk.
+   @param len length of the chunk's data.
+ */
+static void endChunk(unsigned char *p, size_t len)
+{
+  putBig(p + 8 + len, crc32(p + 4, len + 4));
+}
+
+/**
+   Return the offset in a PNG file of the first stored block of the given row.
+   @param image the image.
+   @param y the row.
+   @return offset of the row.
+ */
+static size_t rowStart(Image const *image, int y)
+{
+  return image->first + y * image->stride + (size_t) (y / image->bandRows) * CHUNK_EXTRA;
+}
+
+/**
+   Work out where everything goes in an image file of the given format and size,
+   without allocating anything.
+   @param image image to lay out.
+   @param format format of the file, FormatP6 or FormatPNG.
+   @param size width and height of the image.
+ */
+static void layoutImage(Image *image, ImageFormat format, int size)
+{
+  image->format = format;
+  image->size = size;
+  image->data = NULL;
+  image->pieces = 1;
+  image->bandRows = BAND_ROWS;
+  image->bands = (size + BAND_ROWS - 1) / BAND_ROWS;
+  image->adlers = NULL;
+  if (format == FormatP6) {
+    char header[64];
+    image->first = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", size, size);
+    image->stride = (size_t) size * 3;
+    image->len = image->first + image->stride * size;
+    return;
+  }
+
+  // Every row starts with a filter byte, and is split into as many stored blocks as it needs.
+  size_t raw = 1 + (size_t) size * 3;
+  image->pieces = (raw + STORED_MAX - 1) / STORED_MAX;
+  image->stride = raw + STORED_HEADER * image->pieces;
+  int fit = (CHUNK_MAX - ZLIB_HEADER - ZLIB_TRAILER) / image->stride;
+  image->bandRows = fit < BAND_ROWS ? fit : BAND_ROWS;
+  image->bands = (size + image->bandRows - 1) / image->bandRows;
+  image->first = PNG_HEAD + 8 + ZLIB_HEADER;
+  image->len = PNG_HEAD + ZLIB_HEADER + image->stride * size + ZLIB_TRAILER
+    + (size_t) image->bands * CHUNK_EXTRA + CHUNK_EXTRA;
+}
+
+/**
+   Write the start of an image file, everything before the chunks of a PNG file
+   or before the first row of a PPM file.
+   @param image the image.
+   @param p place to write it.
+   @return the number of bytes written.
+ */
+static size_t writeHead(Image const *image, unsigned char *p)
+{
+  if (image->format == FormatP6) {
+    char header[64];
+    snprintf(header, sizeof(header), "P6\n%d %d\n255\n", image->size, image->size);
+    memcpy(p, header, image->first);
+    return image->first;
+  }
+
+  // Signature and header, with 8-bit RGB pixels.
+  memcpy(p, "\x89PNG\r\n\x1a\n", 8);
+  p += 8;
+  startChunk(p, 13, "IHDR");
+  putBig(p + 8, image->size);
+  putBig(p + 12, image->size);
+  memcpy(p + 16, "\x08\x02\x00\x00\x00", 5);
+  endChunk(p, 13);
+  return PNG_HEAD;
+}
+
+bool initImage(Image *image, ImageFormat format, int size)
+{
+  layoutImage(image, format, size);
+  image->data = malloc(image->len);
+  if (format == FormatPNG) {
+    image->adlers = malloc(image->bands * sizeof(uint32_t));
+  }
+  if (!image->data || (format == FormatPNG && !image->adlers)) {
+    return false;
+  }
+  initCRC();
+  writeHead(image, image->data);
+  if (format == FormatP6) {
+    return true;
+  }
+
+  // Each IDAT chunk's length and type; the zlib header, for a 32K window and no dictionary.
+  unsigned char *p = image->data + PNG_HEAD;
+  for (int c = 0; c < image->bands; c++) {
+    size_t len = chunkData(image, c);
+    startChunk(p, len, "IDAT");
+    p += len + CHUNK_EXTRA;
+  }
+  image->data[PNG_HEAD + 8] = 0x78;
+  image->data[PNG_HEAD + 9] = 0x01;
+  startChunk(p, 0, "IEND");
+  endChunk(p, 0);
+  return true;
+}
+
+unsigned char *rowPixels(Image const *image, int y)
+{
+  if (image->format == FormatP6) {
+    return image->data + image->first + y * image->stride;
+  }
+  if (image->pieces > 1) {
+    return NULL;
+  }
+  return image->data + rowStart(image, y) + STORED_HEADER + 1;
+}
+
+/**
+   Write a row of a PNG file as stored blocks: the filter byte, then the pixels, cut into blocks
+   no bigger than a stored block can be.  The very last block of the image is marked final.
+   @param image the image.
+   @param y the row.
+   @param p place for the row's first block.
+   @param pixels the row's pixels, which may already be in place after the first block's header
+   and filter byte.
+ */
+static void storeBlocks(Image const *image, int y, unsigned char *p, unsigned char const *pixels)
+{
+  size_t raw = 1 + (size_t) image->size * 3;
+  for (int i = 0; i < image->pieces; i++) {
+    size_t start = (size_t) i * STORED_MAX;
+    size_t n = raw - start < STORED_MAX ? raw - start : STORED_MAX;
+    p[0] = y == image->size - 1 && i == image->pieces - 1;
+    p[1] = n;
+    p[2] = n >> 8;
+    p[3] = ~n;
+    p[4] = ~n >> 8;
+    p += STORED_HEADER;
+    if (start == 0) {
+      *p = 0;
+      if (p + 1 != pixels) {
+        memcpy(p + 1, pixels, n - 1);
+      }
+    }
+    else {
+      memcpy(p, pixels + start - 1, n);
+    }
+    p += n;
+  }
+}
+
+void storeRow(Image *image, int y, unsigned char const *pixels)
+{
+  if (image->format == FormatP6) {
+    unsigned char *p = image->data + image->first + y * image->stride;
+    if (p != pixels) {
+      memcpy(p, pixels, image->stride);
+    }
+    return;
+  }
+  storeBlocks(image, y, image->data + rowStart(image, y), pixels);
+}
+
+/**
+   Return the offset in a PNG file of the IDAT chunk for the given band.
+   @param image the image.
+   @param band index of the band.
+   @return offset of the chunk.
+ */
+static size_t chunkStart(Image const *image, int band)
+{
+  return band == 0 ? PNG_HEAD : rowStart(image, band * image->bandRows) - 8;
+}
+
+void finishBand(Image *image, int band)
+{
+  if (image->format != FormatPNG) {
+    return;
+  }
+
+  // The Adler-32 checksum covers the rows without their block headers.
+  uint32_t adler = 1;
+  size_t raw = 1 + (size_t) image->size * 3;
+  int end = (band + 1) * image->bandRows;
+  end = end < image->size ? end : image->size;
+  for (int y = band * image->bandRows; y < end; y++) {
+    unsigned char const *p = image->data + rowStart(image, y);
+    for (size_t start = 0; start < raw; start += STORED_MAX) {
+      size_t n = raw - start < STORED_MAX ? raw - start : STORED_MAX;
+      adler = adler32(adler, p + STORED_HEADER, n);
+      p += STORED_HEADER + n;
+    }
+  }
+  image->adlers[band] = adler;
+
+  // The last chunk's CRC has to wait for the checksum of the whole stream.
+  if (band < image->bands - 1) {
+    endChunk(image->data + chunkStart(image, band), chunkData(image, band));
+  }
+}
+
+void finishImage(Image *image)
+{
+  if (image->format != FormatPNG) {
+    return;
+  }
+  uint32_t adler = 1;
+  size_t raw = 1 + (size_t) image->size * 3;
+  for (int c = 0; c < image->bands; c++) {
+    int rows = image->size - c * image->bandRows;
+    rows = rows < image->bandRows ? rows : image->bandRows;
+    adler = combineAdler(adler, image->adlers[c], rows * raw);
+  }
+  putBig(image->data + rowStart(image, image->size - 1) + image->stride, adler);
+  int last = image->bands - 1;
+  endChunk(image->data + chunkStart(image, last), chunkData(image, last));
+}
+
+void freeImage(Image *image)
+{
+  free(image->data);
+  free(image->adlers);
+}
+
+bool initStream(Stream *stream, ImageFormat format, int size)
+{
+  Image *image = &stream->image;
+  layoutImage(image, format, size);
+  stream->adler = 1;
+
+  // Room for the start of the file, or for the biggest chunk and the IEND chunk after it.
+  size_t room = PNG_HEAD;
+  if (format == FormatPNG) {
+    size_t chunk = image->bandRows * image->stride + ZLIB_HEADER + ZLIB_TRAILER + 2 * CHUNK_EXTRA;
+    room = chunk > room ? chunk : room;
+  }
+  image->data = malloc(room);
+  if (!image->data) {
+    return false;
+  }
+  initCRC();
+  return true;
+}
+
+unsigned char const *streamHead(Stream *stream, size_t *len)
+{
+  stream->adler = 1;
+  *len = writeHead(&stream->image, stream->image.data);
+  return stream->image.data;
+}
+
+unsigned char const *streamBand(Stream *stream, int band, unsigned char const *pixels,
+                                size_t *len)
+{
+  Image const *image = &stream->image;
+  int begin = band * image->bandRows;
+  int end = begin + image->bandRows < image->size ? begin + image->bandRows : image->size;
+  size_t width = (size_t) image->size * 3;
+  if (image->format == FormatP6) {
+    *len = (end - begin) * width;
+    return pixels;
+  }
+
+  // The band's IDAT chunk, just as it is in the whole file.
+  unsigned char *chunk = image->data;
+  size_t data = chunkData(image, band);
+  startChunk(chunk, data, "IDAT");
+  unsigned char *p = chunk + 8;
+  if (band == 0) {
+    *p++ = 0x78;
+    *p++ = 0x01;
+  }
+  unsigned char const filter = 0;
+  for (int y = begin; y < end; y++) {
+    unsigned char const *row = pixels + (y - begin) * width;
+    storeBlocks(image, y, p, row);
+    stream->adler = adler32(adler32(stream->adler, &filter, 1), row, width);
+    p += image->stride;
+  }
+  if (band == image->bands - 1) {
+    putBig(p, stream->adler);
+  }
+  endChunk(chunk, data);
+  *len = data + CHUNK_EXTRA;
+
+  // The IEND chunk follows the last one.
+  if (band == image->bands - 1) {
+    startChunk(chunk + *len, 0, "IEND");
+    endChunk(chunk + *len, 0);
+    *len += CHUNK_EXTRA;
+  }
+  return chunk;
+}
+
+void freeStream(Stream *stream)
+{
+  free(stream->image.data);
+}
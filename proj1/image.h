@@ -0,0 +1,162 @@
+/**
+   @file image.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the image.c component, which lays out a whole binary PPM (P6) or PNG file
+   in one buffer, so the rows of pixels can be painted straight into their places in the file
+   and the finished file written out at once.  The rows are grouped into bands that can be
+   painted and finished by different threads, and the file is the same however that's done.
+   Images too big for memory can be streamed out a band at a time instead.
+   PNG files are written without compression, as zlib stored blocks,
+   so no compression library is needed.
+ */
+
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Formats an image can be written in. */
+typedef enum {
+  /** Text PPM, with each color intensity written out in decimal. */
+  FormatP3,
+
+  /** Binary PPM, with a byte for each color intensity. */
+  FormatP6,
+
+  /** PNG, with the pixels stored uncompressed. */
+  FormatPNG
+} ImageFormat;
+
+/** Largest number of rows in a band. */
+#define BAND_ROWS 64
+
+/** A binary image file, laid out in memory. */
+typedef struct {
+  /** Format of the file, FormatP6 or FormatPNG. */
+  ImageFormat format;
+
+  /** Width and height of the image. */
+  int size;
+
+  /** The whole file, and its length. */
+  unsigned char *data;
+  size_t len;
+
+  /** Offset in the file of the first row, and the number of bytes from one row to the next. */
+  size_t first;
+  size_t stride;
+
+  /** Number of stored blocks each row of a PNG file is split into, to fit their size limit. */
+  int pieces;
+
+  /**
+     Number of rows in each band, and the number of bands.
+     Each band of a PNG file is an IDAT chunk of its own.
+   */
+  int bandRows;
+  int bands;
+
+  /** Adler-32 checksum of the rows of each band of a PNG file, once it's finished. */
+  uint32_t *adlers;
+} Image;
+
+/**
+   Lay out an image file of the given format and size, with the headers filled in.
+   @param image image to set up.
+   @param format format of the file, FormatP6 or FormatPNG.
+   @param size width and height of the image.
+   @return false if there isn't enough memory for the file.
+ */
+bool initImage(Image *image, ImageFormat format, int size);
+
+/**
+   Return where the pixels of the given row go in the file, three bytes for each pixel,
+   so they can be painted in place.
+   @param image image the row is in.
+   @param y the row, counting from the top.
+   @return the place for the row's pixels, or NULL if the row is split up in the file,
+   so it has to be painted somewhere else and copied in by storeRow().
+ */
+unsigned char *rowPixels(Image const *image, int y);
+
+/**
+   Finish the given row of the file, copying the row's pixels in unless they were painted in place.
+   Different rows can be stored by different threads at once.
+   @param image image the row is in.
+   @param y the row, counting from the top.
+   @param pixels the row's pixels, three bytes for each.
+ */
+void storeRow(Image *image, int y, unsigned char const *pixels);
+
+/**
+   Work out the checksums for a band, once all its rows have been stored.
+   Different bands can be finished by different threads at once.
+   @param image image the band is in.
+   @param band index of the band.
+ */
+void finishBand(Image *image, int band);
+
+/**
+   Fill in the checksums for the whole file, once every band has been finished.
+   @param image image to finish.
+ */
+void finishImage(Image *image);
+
+/**
+   Free the memory used by the given image.
+   @param image image to free.
+ */
+void freeImage(Image *image);
+
+/**
+   An image file written out a band at a time, for images too big to lay out in memory.
+   The file is the same as the one an Image would give.
+ */
+typedef struct {
+  /** Layout of the whole file, with only enough data for one band of it. */
+  Image image;
+
+  /** Adler-32 checksum of the rows of a PNG file so far. */
+  uint32_t adler;
+} Stream;
+
+/**
+   Set up a stream for an image file of the given format and size.
+   @param stream stream to set up.
+   @param format format of the file, FormatP6 or FormatPNG.
+   @param size width and height of the image.
+   @return false if there isn't enough memory for a band.
+ */
+bool initStream(Stream *stream, ImageFormat format, int size);
+
+/**
+   Start a file, returning the bytes that go before its first band.
+   @param stream the stream.
+   @param len set to the number of bytes.
+   @return the bytes, which are good until the stream is next used.
+ */
+unsigned char const *streamHead(Stream *stream, size_t *len);
+
+/**
+   Return the bytes of the file for the next band, once its pixels are ready.
+   The bands have to be given in order, one at a time.
+   @param stream the stream.
+   @param band index of the band, with stream->image.bandRows rows in each but the last.
+   @param pixels the band's pixels, three bytes for each, one row after another.
+   @param len set to the number of bytes.
+   @return the bytes, which may be the pixels themselves, and are good until the stream
+   is next used.
+ */
+unsigned char const *streamBand(Stream *stream, int band, unsigned char const *pixels,
+                                size_t *len);
+
+/**
+   Free the memory used by the given stream.
+   @param stream stream to free.
+ */
+void freeStream(Stream *stream);
+
+#endif
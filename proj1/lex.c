@@ -0,0 +1,183 @@
+/**
+   @file lex.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Tables for the state machines dent uses to decide which curly brackets count.
+   Each table is a couple of hundred bytes, so they stay in the L1 cache,
+   and following one takes a lookup instead of a chain of comparisons.
+ */
+
+#include "lex.h"
+#include <string.h>
+
+Lexer plainLexer;
+
+Lexer cLexer;
+
+/** Stop characters for plain code: brackets, the start of a string and the end of a line. */
+static ScanSet plainCodeStops;
+
+/** Stop characters in a plain string: its end, and newlines so lines inside it can be counted. */
+static ScanSet plainStringStops;
+
+/** Stop characters for C code. */
+static ScanSet cCodeStops;
+
+/** Stop characters in a C string. */
+static ScanSet cStringStops;
+
+/** Stop characters in a C character literal. */
+static ScanSet cCharStops;
+
+/** Stop characters in a comment that runs to the end of the line. */
+static ScanSet lineCommentStops;
+
+/** Stop characters in a block comment. */
+static ScanSet blockCommentStops;
+
+/**
+   Set up the given lexer so every character is ClassOther and leaves every state unchanged.
+   @param lex lexer to set up.
+   @param id number identifying the lexer.
+ */
+static void startLexer(Lexer *lex, int id)
+{
+  memset(lex, 0, sizeof(Lexer));
+  lex->id = id;
+  for (int s = 0; s < STATE_COUNT; s++) {
+    for (int c = 0; c < CLASS_COUNT; c++) {
+      lex->table[s][c].next = s;
+    }
+  }
+}
+
+/**
+   Set the transition for the given state and kind of character.
+   @param lex lexer to change.
+   @param state state the character is seen in.
+   @param cls kind of the character.
+   @param next state to move to.
+   @param delta change in the indentation depth.
+ */
+static void setTransition(Lexer *lex, ScanState state, CharClass cls, ScanState next, int delta)
+{
+  lex->table[state][cls].next = next;
+  lex->table[state][cls].delta = delta;
+}
+
+/**
+   Set every transition out of the given state to go to the same next state.
+   @param lex lexer to change.
+   @param state state to change.
+   @param next state to move to on any character.
+ */
+static void setAll(Lexer *lex, ScanState state, ScanState next)
+{
+  for (int c = 0; c < CLASS_COUNT; c++) {
+    setTransition(lex, state, c, next, 0);
+  }
+}
+
+/**
+   Finish the given lexer.  Once whitespace has been skipped, the start of a line
+   behaves just like the rest of it.  The states that can follow a newline are noted,
+   looking only at the states the lexer can actually reach.
+   @param lex lexer to finish.
+ */
+static void finishLexer(Lexer *lex)
+{
+  memcpy(lex->table[LineStart], lex->table[InLine], sizeof(lex->table[InLine]));
+  lex->stops[LineStart] = lex->stops[InLine];
+
+  bool reached[STATE_COUNT] = { [LineStart] = true };
+  for (bool grew = true; grew; ) {
+    grew = false;
+    for (int s = 0; s < STATE_COUNT; s++) {
+      for (int c = 0; reached[s] && c < CLASS_COUNT; c++) {
+        if (!reached[lex->table[s][c].next]) {
+          reached[lex->table[s][c].next] = grew = true;
+        }
+      }
+    }
+  }
+  for (int s = 0; s < STATE_COUNT; s++) {
+    if (reached[s]) {
+      lex->lineEntry[lex->table[s][ClassNewline].next] = true;
+    }
+  }
+}
+
+void initLexers()
+{
+  initScanSet(&plainCodeStops, "{}\"\n");
+  initScanSet(&plainStringStops, "\"\n");
+  initScanSet(&cCodeStops, "{}\"'/\n");
+  initScanSet(&cStringStops, "\"\\\n");
+  initScanSet(&cCharStops, "'\\\n");
+  initScanSet(&lineCommentStops, "\n");
+  initScanSet(&blockCommentStops, "*\n");
+
+  // The plain lexer only has code and double-quoted strings, with no escapes.
+  Lexer *lex = &plainLexer;
+  startLexer(lex, 0);
+  lex->classOf['{'] = ClassOpen;
+  lex->classOf['}'] = ClassClose;
+  lex->classOf['"'] = ClassQuote;
+  lex->classOf['\n'] = ClassNewline;
+  setTransition(lex, InLine, ClassOpen, InLine, 1);
+  setTransition(lex, InLine, ClassClose, InLine, -1);
+  setTransition(lex, InLine, ClassQuote, InString, 0);
+  setTransition(lex, InLine, ClassNewline, LineStart, 0);
+  setTransition(lex, InString, ClassQuote, InLine, 0);
+  lex->stops[InLine] = &plainCodeStops;
+  lex->stops[InString] = &plainStringStops;
+  lex->literal[InString] = true;
+  finishLexer(lex);
+
+  // The C lexer adds comments, character literals and escapes.
+  lex = &cLexer;
+  startLexer(lex, 1);
+  lex->classOf['{'] = ClassOpen;
+  lex->classOf['}'] = ClassClose;
+  lex->classOf['"'] = ClassQuote;
+  lex->classOf['\''] = ClassApostrophe;
+  lex->classOf['/'] = ClassSlash;
+  lex->classOf['*'] = ClassStar;
+  lex->classOf['\\'] = ClassBackslash;
+  lex->classOf['\n'] = ClassNewline;
+  setTransition(lex, InLine, ClassOpen, InLine, 1);
+  setTransition(lex, InLine, ClassClose, InLine, -1);
+  setTransition(lex, InLine, ClassQuote, InString, 0);
+  setTransition(lex, InLine, ClassApostrophe, InChar, 0);
+  setTransition(lex, InLine, ClassSlash, Slash, 0);
+  setTransition(lex, InLine, ClassNewline, LineStart, 0);
+
+  // A slash that doesn't start a comment is just code.
+  memcpy(lex->table[Slash], lex->table[InLine], sizeof(lex->table[InLine]));
+  setTransition(lex, Slash, ClassOther, InLine, 0);
+  setTransition(lex, Slash, ClassStar, BlockComment, 0);
+  setTransition(lex, Slash, ClassBackslash, InLine, 0);
+  setTransition(lex, Slash, ClassSlash, LineComment, 0);
+
+  setTransition(lex, InString, ClassQuote, InLine, 0);
+  setTransition(lex, InString, ClassBackslash, StringEscape, 0);
+  setAll(lex, StringEscape, InString);
+  setTransition(lex, InChar, ClassApostrophe, InLine, 0);
+  setTransition(lex, InChar, ClassBackslash, CharEscape, 0);
+  setAll(lex, CharEscape, InChar);
+  setTransition(lex, LineComment, ClassNewline, LineStart, 0);
+  setTransition(lex, BlockComment, ClassStar, BlockStar, 0);
+  setAll(lex, BlockStar, BlockComment);
+  setTransition(lex, BlockStar, ClassStar, BlockStar, 0);
+  setTransition(lex, BlockStar, ClassSlash, InLine, 0);
+
+  lex->stops[InLine] = &cCodeStops;
+  lex->stops[InString] = &cStringStops;
+  lex->stops[InChar] = &cCharStops;
+  lex->stops[LineComment] = &lineCommentStops;
+  lex->stops[BlockComment] = &blockCommentStops;
+  lex->literal[InString] = lex->literal[StringEscape] = true;
+  lex->literal[InChar] = lex->literal[CharEscape] = true;
+  lex->literal[BlockComment] = lex->literal[BlockStar] = true;
+  finishLexer(lex);
+}
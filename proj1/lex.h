@@ -0,0 +1,111 @@
+/**
+   @file lex.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the lex.c component, with the table-driven state machines dent uses
+   to decide which curly brackets count.  The plain one only knows about double-quoted strings,
+   and the C one also knows about comments, character literals and backslash escapes.
+ */
+
+#ifndef _LEX_H_
+#define _LEX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scan.h"
+
+/** Where the scanner is relative to the structure of the current line. */
+typedef enum {
+  /** Discarding the whitespace at the start of a line. */
+  LineStart,
+
+  /** Copying the body of a line, watching for brackets and quotes. */
+  InLine,
+
+  /** Copying the contents of a double-quoted string literally. */
+  InString,
+
+  /** Just after a backslash in a string. */
+  StringEscape,
+
+  /** Copying the contents of a character literal. */
+  InChar,
+
+  /** Just after a backslash in a character literal. */
+  CharEscape,
+
+  /** Just after a slash, which might start a comment. */
+  Slash,
+
+  /** Copying a comment that runs to the end of the line. */
+  LineComment,
+
+  /** Copying a comment that runs to a star and a slash. */
+  BlockComment,
+
+  /** Just after a star in a block comment, which might end it. */
+  BlockStar
+} ScanState;
+
+/** Number of states in ScanState. */
+#define STATE_COUNT 10
+
+/** Kinds of characters the state machines tell apart. */
+typedef enum {
+  ClassOther, ClassOpen, ClassClose, ClassQuote, ClassApostrophe,
+  ClassSlash, ClassStar, ClassBackslash, ClassNewline
+} CharClass;
+
+/** Number of kinds of characters in CharClass. */
+#define CLASS_COUNT 9
+
+/** What happens when the state machine sees a character. */
+typedef struct {
+  /** State after the character. */
+  uint8_t next;
+
+  /** Change in the indentation depth, -1, 0 or 1. */
+  int8_t delta;
+} Transition;
+
+/**
+   A table-driven state machine for deciding which curly brackets count.
+   Other characters never change the state in the states with a set of stop characters,
+   so the scanner can skip straight to the next stop character in those.
+ */
+typedef struct {
+  /** Number saved in checkpoint indexes, so an index is only used with the lexer that made it. */
+  int id;
+
+  /** Kind of each byte value. */
+  uint8_t classOf[256];
+
+  /** Transition for each state and kind of character. */
+  Transition table[STATE_COUNT][CLASS_COUNT];
+
+  /** Characters worth stopping at in each state, or NULL to look at every character. */
+  ScanSet const *stops[STATE_COUNT];
+
+  /**
+     True for the states inside a string, character literal or block comment.
+     Lines that start in one of these aren't re-indented,
+     and the input isn't considered unmatched if it ends in one.
+   */
+  bool literal[STATE_COUNT];
+
+  /** True for the states the machine can be in just after a newline. */
+  bool lineEntry[STATE_COUNT];
+} Lexer;
+
+/** The original state machine, which only knows about double-quoted strings. */
+extern Lexer plainLexer;
+
+/** A state machine for C, which also knows about comments, character literals and escapes. */
+extern Lexer cLexer;
+
+/**
+   Fill in the tables for plainLexer and cLexer.
+ */
+void initLexers();
+
+#endif
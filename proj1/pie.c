@@ -5,153 +5,860 @@
    This program draws a pie chart using a very simple image format.
    As input, the program expects relative sizes of three sections of the pie chart.
    It draws one section in red, another in green and another in blue.
+   With -n, it expects that many sections instead, and colors the ones after the third
+   from a fixed palette; with -s, the image is that many pixels wide and high.
+   With -f, the image can be written as a binary PPM or a PNG file instead,
+   and with -j, those are drawn by that many threads, or with -r, streamed out in bands.
+   With -a, the edges are anti-aliased.  With -b, it draws a chart for each line of input,
+   reusing the same memory for each.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "raster.h"
+#include "image.h"
+#include "cache.h"
 
 /** The number of pie slice input from user. */
 #define SLICES 3
 
-/** The size of the image, 100 pixels by 100 pixels. */
-#define SIZE 100
-
 /** RGB values in the range of 0 to 255. */
 #define RGB 255
 
-/** Red slice will drawn first. */
-#define RED 1
-
-/** Green slice will be drawn second. */
-#define GREEN 2
-
-/** Blue slice will be drawn third. */
-#define BLUE 3
-
-/** The pie chart will be centered at 49.5, 49.5. */
-#define CENTER 49.5
+/** Number of colors in the palette, used in turn for the slices. */
+#define PALETTE 12
 
-/** The pie chart will be drawn in a circle of radius 45. */
-#define PIE_RADIUS 45
+/** Length of the text for one pixel of a P3 image, three intensities of four characters. */
+#define PIXEL_TEXT 12
 
-/** The pie chart will have a 3-pixel border around it. */
-#define BORDER 3
+/** Largest number of threads an image can be drawn with. */
+#define MAX_THREADS 256
 
-/** A mathematical constant. The ratio of a circle's circumference to its diameter. */
-#define PI 3.14159265358979
+/** Number of bands of pixels a streamed image can have in flight, one drawn while one is written. */
+#define STREAM_SLOTS 2
 
 /** Exit code for invalid input. */
 #define EXIT_UNSUCCESS 100
 
-/** Track the color of each pixel. */
-int color = 0;
+/** Color of each slice: red, green and blue first, then the colors between them. */
+static int const palette[PALETTE][3] = {
+  { RGB, 0, 0 }, { 0, RGB, 0 }, { 0, 0, RGB },
+  { RGB, RGB, 0 }, { 0, RGB, RGB }, { RGB, 0, RGB },
+  { RGB, 128, 0 }, { 128, 0, RGB }, { 0, 128, RGB },
+  { RGB, 0, 128 }, { 128, RGB, 0 }, { 0, RGB, 128 }
+};
 
 /**
-   Return true if the given pixel location is inside a circle of radius rad centered at 49.5, 49.5.
-   @param x pixle X coordinate.
-   @param y pixle Y coordinate.
-   @param rad radius of a circle.
-   @return true if the given pixel location is inside a circle of radius rad centered at 49.5, 49.5.
+   Fill in the color of each class of pixel: white for the background,
+   black for the border and the palette for the slices.
+   @param colors table to fill in, PIXEL_SLICE + MAX_SLICES entries.
  */
-bool insideCircle(int x, int y, int rad)
+void makeColors(unsigned char colors[][3])
 {
-  return pow(x-CENTER, 2) + pow(y-CENTER, 2) <= pow(rad, 2);
+  memset(colors[PIXEL_BACKGROUND], RGB, 3);
+  memset(colors[PIXEL_BORDER], 0, 3);
+  for (int k = 0; k < MAX_SLICES; k++) {
+    for (int c = 0; c < 3; c++) {
+      colors[PIXEL_SLICE + k][c] = palette[k % PALETTE][c];
+    }
+  }
 }
 
 /**
-   Return true.
-   Update the global variable color
-   if the vector from the center of the pie chart to the pixel's location
-   is inside a particular slice of the pie chart (red, green, or blue).
-   @param x pixle X coordinate.
-   @param y pixle Y coordinate.
-   @param red relative size of the red slice of the pie chart.
-   @param green relative size of the green slice of the pie chart.
-   @param blue relative size of the blue slice of the pie chart.
-   @return true.
+   Turn a row of pixel classes into their colors, three bytes for each pixel.
+   @param classes class of each pixel in the row.
+   @param size number of pixels in the row.
+   @param colors color of each class.
+   @param rgb set to the colors of the pixels.
  */
-bool insideSlice(int x, int y, int red, int green, int blue)
+void paintRow(unsigned char const *classes, int size, unsigned char const colors[][3],
+              unsigned char *rgb)
 {
-  double first = 2*PI*((double) red)/((double) (red+green+blue))-PI;
-  double second = 2*PI*((double) (red+green))/((double) (red+green+blue))-PI;
-  if (atan2(y-CENTER, x-CENTER) >= -PI && atan2(y-CENTER, x-CENTER) <= first) {
-    color = RED;
+  for (int j = 0; j < size; j++) {
+    memcpy(rgb + 3 * j, colors[classes[j]], 3);
   }
-  else if (atan2(y-CENTER, x-CENTER) >= first && atan2(y-CENTER, x-CENTER) <= second) {
-    color =GREEN;
+}
+
+/**
+   Anti-alias a row of colors, blending the colors of the classes that cover each pixel near
+   an edge.  The rest of the row keeps the solid colors it was painted with.
+   @param chart chart the row is in.
+   @param y the row, counting from the top.
+   @param colors color of each class.
+   @param rgb colors of the pixels in the row, three bytes for each.
+ */
+void smoothRow(Chart const *chart, int y, unsigned char const colors[][3], unsigned char *rgb)
+{
+  Span spans[MAX_EDGES];
+  int count = edgeSpans(chart, y, spans);
+  for (int s = 0; s < count; s++) {
+    for (int j = spans[s].begin; j < spans[s].end; j++) {
+      Blend blend;
+      blendPixel(chart, y, j, &blend);
+      for (int c = 0; c < 3; c++) {
+        double value = 0;
+        for (int b = 0; b < blend.count; b++) {
+          value += blend.shares[b] * colors[blend.classes[b]][c];
+        }
+        rgb[3 * j + c] = (unsigned char) (value + 0.5);
+      }
+    }
   }
-  else {
-    color = BLUE;
+}
+
+/**
+   Write all of the given bytes to the given file descriptor,
+   retrying after short writes and interrupted system calls.
+   @param fd file descriptor to write to.
+   @param buf bytes to write.
+   @param len number of bytes to write.
+   @return false, with errno set, if the bytes couldn't be written.
+ */
+bool writeAll(int fd, unsigned char const *buf, size_t len)
+{
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    buf += n;
+    len -= n;
   }
   return true;
 }
 
+/** A chart being drawn into an image by a pool of threads, a band of rows at a time. */
+typedef struct {
+  /** Chart to draw. */
+  Chart const *chart;
+
+  /** Image to draw it into. */
+  Image *image;
+
+  /** Color of each class of pixel. */
+  unsigned char (*colors)[3];
+
+  /** True if the edges should be anti-aliased. */
+  bool smooth;
+
+  /** Index of the next band a thread should pick up, and a lock protecting it. */
+  int next;
+  pthread_mutex_t lock;
+} Frame;
+
 /**
-   Print out the color intensity in a 3-character field, followed by a space.
-   @param color the color needed to be printed.
+   Thread body for drawing an image, taking bands of rows until there are none left.
+   Each band is painted and finished by just one thread, so the image doesn't depend
+   on how many threads there are or which one draws what.
+   @param arg the frame to draw.
+   @return NULL.
  */
-void printcolor(int color)
+void *drawBands(void *arg)
 {
-  if (color == RED) {
-    printf("%3d %3d %3d ", RGB, 0, 0);
+  Frame *frame = arg;
+  Image *image = frame->image;
+  int size = frame->chart->geometry->size;
+  unsigned char *classes = malloc(size);
+  unsigned char *scratch = malloc((size_t) size * 3);
+  if (!classes || !scratch) {
+    perror("pie");
+    exit(EXIT_FAILURE);
+  }
+  while (true) {
+    pthread_mutex_lock(&frame->lock);
+    int band = frame->next++;
+    pthread_mutex_unlock(&frame->lock);
+    if (band >= image->bands) {
+      break;
+    }
+
+    int end = (band + 1) * image->bandRows;
+    end = end < size ? end : size;
+    for (int i = band * image->bandRows; i < end; i++) {
+      unsigned char *rgb = rowPixels(image, i);
+      rgb = rgb ? rgb : scratch;
+      classifyRow(frame->chart, i, classes);
+      paintRow(classes, size, frame->colors, rgb);
+      if (frame->smooth) {
+        smoothRow(frame->chart, i, frame->colors, rgb);
+      }
+      storeRow(image, i, rgb);
+    }
+    finishBand(image, band);
   }
-  else if (color == GREEN) {
-    printf("%3d %3d %3d ", 0, RGB, 0);
+  free(classes);
+  free(scratch);
+  return NULL;
+}
+
+/**
+   Draw the given chart into an image file laid out in memory, and fill in its checksums.
+   The image can be drawn over again with another chart of the same size.
+   @param chart chart to draw.
+   @param image image file to draw it into, the same size as the chart.
+   @param colors color of each class of pixel.
+   @param threads number of threads to draw with.
+   @param smooth true if the edges should be anti-aliased.
+ */
+void drawImage(Chart const *chart, Image *image, unsigned char colors[][3], int threads,
+               bool smooth)
+{
+  Frame frame = { chart, image, colors, smooth, 0, PTHREAD_MUTEX_INITIALIZER };
+  pthread_t workers[MAX_THREADS];
+  for (int i = 1; i < threads; i++) {
+    if (pthread_create(&workers[i], NULL, drawBands, &frame) != 0) {
+      perror("pthread_create");
+      exit(EXIT_FAILURE);
+    }
   }
-  else {
-    printf("%3d %3d %3d ", 0, 0, RGB);
+  drawBands(&frame);
+  for (int i = 1; i < threads; i++) {
+    pthread_join(workers[i], NULL);
   }
+  finishImage(image);
 }
 
 /**
-   Starting point for the program,
-   it reads the sizes of three pie slices from standard input, red, then green then blue.
-   Figures out the color of each pixel and writes the image out to the standard output.
-   @return exit exit status for the program.
+   Return the length of a P3 image of the given size.  Every color intensity
+   takes up four characters, so the length doesn't depend on the colors.
+   @param size width and height of the image.
+   @return number of bytes in the image.
  */
-int main()
+size_t p3Length(int size)
 {
-  int red;
-  int green;
-  int blue;
+  char header[64];
+  size_t len = snprintf(header, sizeof(header), "P3\n%d %d\n%d\n", size, size, RGB);
+  return len + (size_t) size * (12 * (size_t) size + 1);
+}
 
-  // Handle invalid input.
-  int matches = scanf("%d%d%d", &red, &green, &blue);
-  if (matches != SLICES) {
-    printf("Invalid input\n");
-    exit(EXIT_UNSUCCESS);
+/**
+   Read the slice sizes for one chart of a batch from a line of text.
+   @param line the line, holding one to MAX_SLICES sizes separated by spaces.
+   @param sizes set to the sizes.
+   @return the number of sizes, or zero if the line isn't a valid chart: a size is negative
+   or isn't a number, there are too many, or they're all zero.
+ */
+int readSpec(char const *line, int *sizes)
+{
+  int slices = 0;
+  bool empty = true;
+  while (true) {
+    char *end;
+    errno = 0;
+    long n = strtol(line, &end, 10);
+    if (end == line) {
+      break;
+    }
+    if (errno != 0 || n < 0 || n > INT_MAX || slices == MAX_SLICES) {
+      return 0;
+    }
+    sizes[slices++] = n;
+    empty = empty && n == 0;
+    line = end;
+  }
+  while (isspace((unsigned char) *line)) {
+    line++;
+  }
+  return *line == '\0' && !empty ? slices : 0;
+}
+
+/**
+   Return true if the given pattern makes a file name from a chart's number, with exactly one
+   %d conversion, optionally with flags and a width, and no other conversions but %%.
+   @param pattern pattern to check.
+   @return true if it's safe to give to snprintf() with one int.
+ */
+bool validPattern(char const *pattern)
+{
+  int conversions = 0;
+  for (char const *p = pattern; *p; p++) {
+    if (*p != '%') {
+      continue;
+    }
+    p++;
+    if (*p == '%') {
+      continue;
+    }
+    p += strspn(p, "0-+ ");
+    p += strspn(p, "0123456789");
+    if (*p != 'd') {
+      return false;
+    }
+    conversions++;
+  }
+  return conversions == 1;
+}
+
+/** Everything needed to draw charts of one size and format, kept from one chart to the next. */
+typedef struct {
+  /** Format, size and anti-aliasing of the images. */
+  ImageFormat format;
+  int size;
+  bool smooth;
+
+  /** Geometry every chart of that size shares. */
+  Geometry geometry;
+
+  /** Number of threads to draw each binary image with. */
+  int threads;
+
+  /** Image file each binary image is drawn into, laid out when it's first needed. */
+  Image image;
+  bool laidOut;
+
+  /** True if binary images are streamed out a band at a time instead of laid out whole. */
+  bool streaming;
+
+  /**
+     Stream for writing binary images a band at a time, and room for the bands of pixels
+     handed to the thread writing them, set up when they're first needed.
+   */
+  Stream stream;
+  unsigned char *bands[STREAM_SLOTS];
+  bool opened;
+
+  /** Color of each class of pixel. */
+  unsigned char colors[PIXEL_SLICE + MAX_SLICES][3];
+
+  /** Room for a row of classes and a row of colors, for P3 images. */
+  unsigned char *row;
+  unsigned char *rgb;
+
+  /** Each color intensity as P3 text, in a 3-character field followed by a space. */
+  char digits[RGB + 1][4];
+
+  /** The P3 text for the color of each class of pixel. */
+  char cells[PIXEL_SLICE + MAX_SLICES][PIXEL_TEXT];
+
+  /** Room for a row of P3 text, with its newline. */
+  char *text;
+
+  /** Cache of images already drawn, or NULL if there isn't one. */
+  Cache const *cache;
+} Canvas;
+
+/** Name of each image format, for the cache. */
+static char const *const formatNames[] = { "p3", "p6", "png" };
+
+/**
+   Set up a canvas, working out the geometry and allocating the rows once for every chart.
+   @param canvas canvas to set up.
+   @param format format of the images.
+   @param size width and height of the images.
+   @param smooth true if the edges should be anti-aliased.
+   @param threads number of threads to draw each binary image with.
+   @param streaming true if binary images should be streamed out a band at a time.
+   @param cache cache of images already drawn, or NULL.
+ */
+void initCanvas(Canvas *canvas, ImageFormat format, int size, bool smooth, int threads,
+                bool streaming, Cache const *cache)
+{
+  canvas->format = format;
+  canvas->size = size;
+  canvas->smooth = smooth;
+  canvas->threads = threads;
+  canvas->cache = cache;
+  canvas->laidOut = false;
+  canvas->streaming = streaming;
+  canvas->opened = false;
+  makeColors(canvas->colors);
+  for (int v = 0; v <= RGB; v++) {
+    char field[8];
+    snprintf(field, sizeof(field), "%3d ", v);
+    memcpy(canvas->digits[v], field, 4);
+  }
+  for (int k = 0; k < PIXEL_SLICE + MAX_SLICES; k++) {
+    for (int c = 0; c < 3; c++) {
+      memcpy(canvas->cells[k] + 4 * c, canvas->digits[canvas->colors[k][c]], 4);
+    }
+  }
+  canvas->row = malloc(size);
+  canvas->rgb = malloc((size_t) size * 3);
+  canvas->text = malloc((size_t) size * PIXEL_TEXT + 1);
+  if (!canvas->row || !canvas->rgb || !canvas->text
+      || !initGeometry(&canvas->geometry, size)) {
+    perror("pie");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+   Free the memory used by a canvas.
+   @param canvas canvas to free.
+ */
+void freeCanvas(Canvas *canvas)
+{
+  free(canvas->row);
+  free(canvas->rgb);
+  free(canvas->text);
+  freeGeometry(&canvas->geometry);
+  if (canvas->laidOut) {
+    freeImage(&canvas->image);
+  }
+  if (canvas->opened) {
+    freeStream(&canvas->stream);
+    for (int i = 0; i < STREAM_SLOTS; i++) {
+      free(canvas->bands[i]);
+    }
+  }
+}
+
+/** A chart being streamed out, its bands handed from the thread drawing them to the one writing them. */
+typedef struct {
+  /** Canvas the chart is drawn on, with the stream and the bands. */
+  Canvas *canvas;
+
+  /** File descriptor to write the image to. */
+  int fd;
+
+  /** Index of the band in each slot, or -1 if the slot is free to draw into. */
+  int filled[STREAM_SLOTS];
+
+  /** Lock protecting the slots, and a condition for waiting for one to change. */
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+} Relay;
+
+/**
+   Wait for a slot to hold the given band, or -1 for it to be free.
+   @param relay the relay.
+   @param slot slot to wait for.
+   @param band band to wait for it to hold.
+ */
+void waitSlot(Relay *relay, int slot, int band)
+{
+  pthread_mutex_lock(&relay->lock);
+  while (relay->filled[slot] != band) {
+    pthread_cond_wait(&relay->changed, &relay->lock);
+  }
+  pthread_mutex_unlock(&relay->lock);
+}
+
+/**
+   Put a band in a slot, or -1 to free it, and wake up the other thread.
+   @param relay the relay.
+   @param slot slot to change.
+   @param band band it holds now.
+ */
+void fillSlot(Relay *relay, int slot, int band)
+{
+  pthread_mutex_lock(&relay->lock);
+  relay->filled[slot] = band;
+  pthread_cond_broadcast(&relay->changed);
+  pthread_mutex_unlock(&relay->lock);
+}
+
+/**
+   Thread body for writing a streamed image, turning each band of pixels into the bytes
+   of the file as it's drawn, and writing them out.
+   @param arg the relay.
+   @return NULL.
+ */
+void *writeBands(void *arg)
+{
+  Relay *relay = arg;
+  Stream *stream = &relay->canvas->stream;
+  for (int band = 0; band < stream->image.bands; band++) {
+    int slot = band % STREAM_SLOTS;
+    waitSlot(relay, slot, band);
+    size_t len;
+    unsigned char const *bytes = streamBand(stream, band, relay->canvas->bands[slot], &len);
+    if (!writeAll(relay->fd, bytes, len)) {
+      perror("write");
+      exit(EXIT_FAILURE);
+    }
+    fillSlot(relay, slot, -1);
+  }
+  return NULL;
+}
+
+/**
+   Draw a chart and stream it out a band at a time, so only a few bands are ever in memory.
+   Drawing one band goes on while the one before it is written.
+   @param canvas canvas to draw on, with its stream set up.
+   @param chart chart to draw.
+   @param fd file descriptor to write the image to.
+ */
+void streamChart(Canvas *canvas, Chart const *chart, int fd)
+{
+  Stream *stream = &canvas->stream;
+  size_t len;
+  unsigned char const *head = streamHead(stream, &len);
+  if (!writeAll(fd, head, len)) {
+    perror("write");
+    exit(EXIT_FAILURE);
   }
-  if (red < 0 || green < 0 || blue < 0 || (red == 0 && green == 0 && blue == 0)) {
-    printf("Invalid input\n");
-    exit(EXIT_UNSUCCESS);
+
+  Relay relay = { canvas, fd, { -1, -1 }, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+  pthread_t writer;
+  if (pthread_create(&writer, NULL, writeBands, &relay) != 0) {
+    perror("pthread_create");
+    exit(EXIT_FAILURE);
   }
+  int size = canvas->size;
+  int rows = stream->image.bandRows;
+  for (int band = 0; band < stream->image.bands; band++) {
+    int slot = band % STREAM_SLOTS;
+    waitSlot(&relay, slot, -1);
+    int end = (band + 1) * rows < size ? (band + 1) * rows : size;
+    for (int i = band * rows; i < end; i++) {
+      unsigned char *rgb = canvas->bands[slot] + (size_t) (i - band * rows) * size * 3;
+      classifyRow(chart, i, canvas->row);
+      paintRow(canvas->row, size, canvas->colors, rgb);
+      if (canvas->smooth) {
+        smoothRow(chart, i, canvas->colors, rgb);
+      }
+    }
+    fillSlot(&relay, slot, band);
+  }
+  pthread_join(writer, NULL);
+  pthread_mutex_destroy(&relay.lock);
+  pthread_cond_destroy(&relay.changed);
+}
+
+/**
+   Print the given chart as a P3 image, a row at a time.  Each row is built by copying
+   the text for each pixel's color out of the canvas's tables, and written all at once.
+   @param canvas canvas to draw on.
+   @param chart chart to print.
+   @param out file to print to.
+ */
+void printP3(Canvas *canvas, Chart const *chart, FILE *out)
+{
+  int size = canvas->size;
 
   // Header.
-  printf("P3\n");
-  printf("%d %d\n", SIZE, SIZE);
-  printf("%d\n", RGB);
-
-  // Figure out the color of each pixel and write out its color intensity.
-  for (int i = 0; i < SIZE; i++) {
-    for (int j = 0; j < SIZE; j++) {
-      // Check if the pixel is inside the pie chart.
-      if (insideCircle(j, i, PIE_RADIUS)) {
-        // Check which slide the pixel is part of and write out the color.
-        if (insideSlice(j, i, red, green, blue)) {
-          printcolor(color);
+  fprintf(out, "P3\n");
+  fprintf(out, "%d %d\n", size, size);
+  fprintf(out, "%d\n", RGB);
+
+  // Figure out the color of each pixel a row at a time and write out its color intensity.
+  char *text = canvas->text;
+  size_t len = (size_t) size * PIXEL_TEXT + 1;
+  text[len - 1] = '\n';
+  for (int i = 0; i < size; i++) {
+    classifyRow(chart, i, canvas->row);
+    if (canvas->smooth) {
+      unsigned char *rgb = canvas->rgb;
+      paintRow(canvas->row, size, canvas->colors, rgb);
+      smoothRow(chart, i, canvas->colors, rgb);
+      for (int j = 0; j < 3 * size; j++) {
+        memcpy(text + 4 * j, canvas->digits[rgb[j]], 4);
+      }
+    }
+    else {
+      for (int j = 0; j < size; j++) {
+        memcpy(text + PIXEL_TEXT * j, canvas->cells[canvas->row[j]], PIXEL_TEXT);
+      }
+    }
+    fwrite(text, 1, len, out);
+  }
+}
+
+/**
+   Draw a chart on a canvas and write out the image.
+   @param canvas canvas to draw on.
+   @param chart chart to draw.
+   @param out file to write the image to.
+   @param framed true if the image should be preceded by its length on a line of its own.
+ */
+void renderChart(Canvas *canvas, Chart const *chart, FILE *out, bool framed)
+{
+  if (canvas->format == FormatP3) {
+    if (framed) {
+      fprintf(out, "%zu\n", p3Length(canvas->size));
+    }
+    printP3(canvas, chart, out);
+    return;
+  }
+  if (canvas->streaming) {
+    if (!canvas->opened) {
+      if (!initStream(&canvas->stream, canvas->format, canvas->size)) {
+        perror("pie");
+        exit(EXIT_FAILURE);
+      }
+      size_t band = (size_t) canvas->stream.image.bandRows * canvas->size * 3;
+      for (int i = 0; i < STREAM_SLOTS; i++) {
+        canvas->bands[i] = malloc(band);
+        if (!canvas->bands[i]) {
+          perror("pie");
+          exit(EXIT_FAILURE);
         }
       }
-      // Check if the pixel is inside the black border.
-      else if (insideCircle(j, i, PIE_RADIUS+BORDER)) {
-        printf("%3d %3d %3d ", 0, 0, 0);
+      canvas->opened = true;
+    }
+    if (framed) {
+      fprintf(out, "%zu\n", canvas->stream.image.len);
+    }
+    if (fflush(out) != 0) {
+      perror("write");
+      exit(EXIT_FAILURE);
+    }
+    streamChart(canvas, chart, fileno(out));
+    return;
+  }
+  if (!canvas->laidOut) {
+    if (!initImage(&canvas->image, canvas->format, canvas->size)) {
+      perror("pie");
+      exit(EXIT_FAILURE);
+    }
+    canvas->laidOut = true;
+  }
+  drawImage(chart, &canvas->image, canvas->colors, canvas->threads, canvas->smooth);
+  if (framed) {
+    fprintf(out, "%zu\n", canvas->image.len);
+  }
+  if (fflush(out) != 0 || !writeAll(fileno(out), canvas->image.data, canvas->image.len)) {
+    perror("write");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+   Write out the image for a chart with the given slice sizes, copying it from the cache
+   if it's been drawn before, and drawing it and adding it to the cache if it hasn't.
+   @param canvas canvas to draw on.
+   @param sizes relative sizes of the slices.
+   @param slices number of slices.
+   @param out file to write the image to.
+   @param framed true if the image should be preceded by its length on a line of its own.
+ */
+void drawChart(Canvas *canvas, int const *sizes, int slices, FILE *out, bool framed)
+{
+  Chart chart;
+  initChart(&chart, &canvas->geometry, sizes, slices);
+  if (!canvas->cache) {
+    renderChart(canvas, &chart, out, framed);
+    return;
+  }
+
+  char key[CACHE_KEY];
+  makeKey(key, canvas->size, formatNames[canvas->format], canvas->smooth, sizes, slices);
+  size_t len;
+  int fd = findEntry(canvas->cache, key, &len);
+  if (fd < 0) {
+    Entry entry;
+    if (!startEntry(canvas->cache, &entry, key)) {
+      perror(canvas->cache->dir);
+      exit(EXIT_FAILURE);
+    }
+    renderChart(canvas, &chart, entry.fp, false);
+    fd = finishEntry(canvas->cache, &entry, &len);
+    if (fd < 0) {
+      perror(canvas->cache->dir);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (framed) {
+    fprintf(out, "%zu\n", len);
+  }
+  if (fflush(out) != 0 || !copyEntry(fd, len, fileno(out))) {
+    perror("write");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+   Draw a batch of charts, one for each line of standard input, all on the same canvas.
+   Without a pattern, each image goes to standard output as a frame: its length in bytes on a
+   line of its own, then the image.  With one, the image for the chart on line n goes to the
+   file the pattern names for n.  A line that isn't a valid chart is reported, and gets an empty
+   frame on standard output and no file.
+   @param canvas canvas to draw on.
+   @param pattern pattern for the names of the files to write, or NULL for standard output.
+   @return exit status for the program, EXIT_UNSUCCESS if any of the lines were invalid.
+ */
+int drawBatch(Canvas *canvas, char const *pattern)
+{
+  size_t nameLen = strlen(pattern ? pattern : "") + 32;
+  char *name = malloc(nameLen);
+  if (!name) {
+    perror("pie");
+    exit(EXIT_FAILURE);
+  }
+
+  int status = EXIT_SUCCESS;
+  char *line = NULL;
+  size_t cap = 0;
+  for (int number = 1; getline(&line, &cap, stdin) != -1; number++) {
+    int sizes[MAX_SLICES];
+    int slices = readSpec(line, sizes);
+    if (slices == 0) {
+      fprintf(stderr, "pie: line %d: Invalid input\n", number);
+      status = EXIT_UNSUCCESS;
+      if (!pattern) {
+        printf("0\n");
       }
-      else {
-        printf("%3d %3d %3d ", RGB, RGB, RGB);
+      continue;
+    }
+
+    FILE *out = stdout;
+    if (pattern) {
+      snprintf(name, nameLen, pattern, number);
+      out = fopen(name, "wb");
+      if (!out) {
+        perror(name);
+        exit(EXIT_FAILURE);
       }
     }
-    printf("\n");
+    drawChart(canvas, sizes, slices, out, !pattern);
+    if (pattern && fclose(out) != 0) {
+      perror(name);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (fflush(stdout) != 0 || ferror(stdout)) {
+    perror("write");
+    exit(EXIT_FAILURE);
   }
+
+  free(line);
+  free(name);
+  return status;
+}
+
+/**
+   Print out a message for invalid input and exit.
+ */
+void invalid()
+{
+  printf("Invalid input\n");
+  exit(EXIT_UNSUCCESS);
+}
+
+/**
+   Print out how to run the program and exit.
+ */
+void usage()
+{
+  fprintf(stderr, "usage: pie [-a] [-s size] [-n slices] [-f p3]\n"
+          "       pie [-a] [-s size] [-n slices] -f p6|png [-j threads | -r]\n"
+          "       pie -b [-a] [-s size] [-f p3|p6|png] [-j threads | -r] [-o pattern]\n"
+          "       with any of these, [-c cachedir [-l bytes]]\n"
+          "       pie -c cachedir -S\n");
+  exit(EXIT_FAILURE);
+}
+
+/**
+   Starting point for the program,
+   it reads the sizes of three pie slices from standard input, red, then green then blue.
+   Figures out the color of each pixel and writes the image out to the standard output.
+   With -n slices, that many sizes are read, and with -s size, the image is that size.
+   With -f p6 or -f png, the image is written in that format, by as many threads as -j says,
+   or with -r, streamed out a band at a time.  With -a, the edges are anti-aliased.
+   With -b, a chart is drawn for each line of input, written to standard output or to the
+   files -o names.  With -c, images are kept in a cache directory, up to the number of bytes
+   -l gives, and -S reports the cache's counters.
+   @param argc the number of command-line arguments.
+   @param argv command-line arguments.
+   @return exit exit status for the program.
+ */
+int main(int argc, char *argv[])
+{
+  int size = SIZE;
+  int slices = SLICES;
+  ImageFormat format = FormatP3;
+  int threads = 1;
+  bool smooth = false;
+  bool batch = false;
+  bool streaming = false;
+  bool counted = false;
+  char const *pattern = NULL;
+  char const *dir = NULL;
+  long long limit = CACHE_LIMIT;
+  bool limited = false;
+  bool report = false;
+  bool wrong = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "as:n:f:j:rbo:c:l:S")) != -1) {
+    if (opt == 'a') {
+      smooth = true;
+    }
+    else if (opt == 'b') {
+      batch = true;
+    }
+    else if (opt == 'r') {
+      streaming = true;
+    }
+    else if (opt == 'o') {
+      pattern = optarg;
+    }
+    else if (opt == 'c') {
+      dir = optarg;
+    }
+    else if (opt == 'l' && atoll(optarg) >= 0) {
+      limit = atoll(optarg);
+      limited = true;
+    }
+    else if (opt == 'S') {
+      report = true;
+    }
+    else if (opt == 's' && atoi(optarg) >= 1 && atoi(optarg) <= MAX_SIZE) {
+      size = atoi(optarg);
+    }
+    else if (opt == 'n' && atoi(optarg) >= 1 && atoi(optarg) <= MAX_SLICES) {
+      slices = atoi(optarg);
+      counted = true;
+    }
+    else if (opt == 'f' && (strcmp(optarg, "p3") == 0 || strcmp(optarg, "p6") == 0
+                            || strcmp(optarg, "png") == 0)) {
+      format = strcmp(optarg, "p3") == 0 ? FormatP3
+        : strcmp(optarg, "p6") == 0 ? FormatP6 : FormatPNG;
+    }
+    else if (opt == 'j' && atoi(optarg) >= 1 && atoi(optarg) <= MAX_THREADS) {
+      threads = atoi(optarg);
+    }
+    else {
+      wrong = true;
+    }
+  }
+  if (wrong || (threads > 1 && (format == FormatP3 || streaming))
+      || (batch && counted) || (pattern && (!batch || !validPattern(pattern)))
+      || ((limited || report) && !dir)) {
+    usage();
+  }
+
+  Cache cache;
+  if (dir && !openCache(&cache, dir, limit)) {
+    perror(dir);
+    exit(EXIT_FAILURE);
+  }
+  if (report) {
+    printCounters(&cache, stdout);
+    return EXIT_SUCCESS;
+  }
+  Canvas canvas;
+  initCanvas(&canvas, format, size, smooth, threads, streaming, dir ? &cache : NULL);
+  if (batch) {
+    int status = drawBatch(&canvas, pattern);
+    freeCanvas(&canvas);
+    return status;
+  }
+
+  // Handle invalid input.
+  int sizes[MAX_SLICES];
+  bool empty = true;
+  for (int k = 0; k < slices; k++) {
+    if (scanf("%d", &sizes[k]) != 1 || sizes[k] < 0) {
+      invalid();
+    }
+    empty = empty && sizes[k] == 0;
+  }
+  if (empty) {
+    invalid();
+  }
+
+  drawChart(&canvas, sizes, slices, stdout, false);
+  freeCanvas(&canvas);
   return EXIT_SUCCESS;
 }
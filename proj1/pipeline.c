@@ -0,0 +1,362 @@
+/**
+   @file pipeline.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Indenting a stream with reading, indenting and writing overlapped on three threads.
+   Each pair of neighbouring stages shares a fixed set of blocks: full ones are queued for the
+   next stage, and it sends them back empty once it's done with them, so no stage waits on
+   another unless it's gotten a whole set of blocks ahead.
+ */
+
+#include "pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+
+/** A block of bytes passed from one stage of the pipeline to the next. */
+typedef struct {
+  /** The bytes in the block, how many there are and how many there's room for. */
+  char *data;
+  size_t len;
+  size_t cap;
+} Block;
+
+/** Blocks waiting to be taken, in the order they were put in. */
+typedef struct {
+  /** Ring of blocks, where the first one is and how many there are. */
+  Block list[PIPE_DEPTH];
+  int head;
+  int count;
+
+  /** True once nothing more will be put in the queue. */
+  bool closed;
+
+  /** Lock protecting the queue, and condition signalled whenever it changes. */
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+} Queue;
+
+/** Connection between two stages, with full blocks going forward and empty ones coming back. */
+typedef struct {
+  Queue full;
+  Queue empty;
+} Link;
+
+/** Everything the stages of the pipeline share. */
+typedef struct {
+  /** File descriptor the input is read from. */
+  int fd;
+
+  /** Pipe written to if indenting stops early, so the reader stops waiting for input. */
+  int wake[2];
+
+  /** Blocks of input, from the reader to the indenter. */
+  Link input;
+
+  /** Blocks of output, from the indenter to the writer. */
+  Link output;
+
+  /** Sink the writer hands the output to, and its context. */
+  DentSink sink;
+  void *context;
+
+  /** True once the sink has failed, and the errno value it failed with. */
+  bool failed;
+  int error;
+
+  /** True if the time spent reading and writing is measured, and the time measured. */
+  bool timed;
+  double readTime;
+  double writeTime;
+} Pipeline;
+
+/**
+   Prepare the given queue, empty.
+   @param queue queue to initialize.
+ */
+static void initQueue(Queue *queue)
+{
+  queue->head = 0;
+  queue->count = 0;
+  queue->closed = false;
+  pthread_mutex_init(&queue->lock, NULL);
+  pthread_cond_init(&queue->changed, NULL);
+}
+
+/**
+   Add a block to the end of the given queue.  Every link has only PIPE_DEPTH blocks,
+   so there's always room for it.
+   @param queue queue to add to.
+   @param block block to add.
+ */
+static void put(Queue *queue, Block block)
+{
+  pthread_mutex_lock(&queue->lock);
+  queue->list[(queue->head + queue->count) % PIPE_DEPTH] = block;
+  queue->count++;
+  pthread_cond_broadcast(&queue->changed);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+   Take the first block from the given queue, waiting for one if it's empty.
+   @param queue queue to take from.
+   @param block set to the block that was taken.
+   @return false if the queue is empty and closed, so there won't be any more blocks.
+ */
+static bool take(Queue *queue, Block *block)
+{
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == 0 && !queue->closed) {
+    pthread_cond_wait(&queue->changed, &queue->lock);
+  }
+  bool found = queue->count > 0;
+  if (found) {
+    *block = queue->list[queue->head];
+    queue->head = (queue->head + 1) % PIPE_DEPTH;
+    queue->count--;
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return found;
+}
+
+/**
+   Mark the given queue as closed, waking up anything waiting for a block from it.
+   @param queue queue to close.
+ */
+static void closeQueue(Queue *queue)
+{
+  pthread_mutex_lock(&queue->lock);
+  queue->closed = true;
+  pthread_cond_broadcast(&queue->changed);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+   Prepare the given link, with PIPE_DEPTH empty blocks of the given size.
+   @param link link to initialize.
+   @param size number of bytes in each block.
+ */
+static void initLink(Link *link, size_t size)
+{
+  initQueue(&link->full);
+  initQueue(&link->empty);
+  for (int i = 0; i < PIPE_DEPTH; i++) {
+    Block block = { malloc(size), 0, size };
+    put(&link->empty, block);
+  }
+}
+
+/**
+   Free the blocks in the given link, full or empty, once nothing is using any of them.
+   @param link link to free.
+ */
+static void freeLink(Link *link)
+{
+  Block block;
+  closeQueue(&link->full);
+  closeQueue(&link->empty);
+  while (take(&link->full, &block) || take(&link->empty, &block)) {
+    free(block.data);
+  }
+}
+
+/**
+   Thread body for the reader, filling empty blocks of input until the end of the input,
+   or until the indenter stops early.  Before each read, it waits for the input or the wake
+   pipe to be ready, so it's never stuck in a read the indenter no longer wants.
+   @param arg the pipeline.
+   @return NULL.
+ */
+static void *readInput(void *arg)
+{
+  Pipeline *pipeline = arg;
+  struct pollfd ready[2] = { { pipeline->fd, POLLIN, 0 }, { pipeline->wake[0], POLLIN, 0 } };
+  Block block;
+  ssize_t n = 1;
+  while (n != 0 && take(&pipeline->input.empty, &block)) {
+    double start = pipeline->timed ? profileClock() : 0;
+    block.len = 0;
+    while (block.len < block.cap && n != 0) {
+      if (poll(ready, 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        perror("poll");
+        exit(EXIT_FAILURE);
+      }
+      if (ready[1].revents) {
+        n = 0;
+        break;
+      }
+      n = read(pipeline->fd, block.data + block.len, block.cap - block.len);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        perror("read");
+        exit(EXIT_FAILURE);
+      }
+      block.len += n;
+    }
+    if (pipeline->timed) {
+      pipeline->readTime += profileClock() - start;
+    }
+    put(&pipeline->input.full, block);
+  }
+  closeQueue(&pipeline->input.full);
+  return NULL;
+}
+
+/**
+   Thread body for the writer, handing each full block of output to the sink.
+   Once the sink fails, blocks are sent back without trying again.
+   @param arg the pipeline.
+   @return NULL.
+ */
+static void *writeOutput(void *arg)
+{
+  Pipeline *pipeline = arg;
+  Block block;
+  while (take(&pipeline->output.full, &block)) {
+    if (!pipeline->failed) {
+      double start = pipeline->timed ? profileClock() : 0;
+      errno = 0;
+      if (!pipeline->sink(pipeline->context, block.data, block.len)) {
+        pipeline->failed = true;
+        pipeline->error = errno;
+      }
+      if (pipeline->timed) {
+        pipeline->writeTime += profileClock() - start;
+      }
+    }
+    put(&pipeline->output.empty, block);
+  }
+  return NULL;
+}
+
+/**
+   Sink the state uses while it's in the pipeline, copying each block of output
+   into an empty block for the writer.
+   @param context the pipeline.
+   @param buf block of output.
+   @param len number of bytes in the block.
+   @return false, with errno set, if the writer has failed.
+ */
+static bool passOn(void *context, char const *buf, size_t len)
+{
+  Pipeline *pipeline = context;
+  Block block;
+  take(&pipeline->output.empty, &block);
+
+  // The writer fails before it sends the block back, so the failure is seen here.
+  if (pipeline->failed) {
+    put(&pipeline->output.empty, block);
+    errno = pipeline->error;
+    return false;
+  }
+  if (len > block.cap) {
+    block.cap = len;
+    block.data = realloc(block.data, block.cap);
+  }
+  memcpy(block.data, buf, len);
+  block.len = len;
+  put(&pipeline->output.full, block);
+  return true;
+}
+
+/**
+   Start a thread running the given function on the pipeline, or exit if it can't be started.
+   @param thread set to the new thread.
+   @param func thread body.
+   @param pipeline the pipeline.
+ */
+static void startStage(pthread_t *thread, void *(*func)(void *), Pipeline *pipeline)
+{
+  if (pthread_create(thread, NULL, func, pipeline) != 0) {
+    perror("pthread_create");
+    exit(EXIT_FAILURE);
+  }
+}
+
+DentStatus indentPipelined(DentState *dent, int fd)
+{
+  Pipeline *pipeline = malloc(sizeof(Pipeline));
+  pipeline->fd = fd;
+  if (pipe(pipeline->wake) != 0) {
+    perror("pipe");
+    exit(EXIT_FAILURE);
+  }
+  initLink(&pipeline->input, PIPE_BLOCK);
+  initLink(&pipeline->output, WRITE_SIZE);
+  pipeline->sink = dent->out.sink;
+  pipeline->context = dent->out.context;
+  pipeline->failed = false;
+  pipeline->error = 0;
+
+  // Writing is timed by the writer, so handing blocks to it isn't counted as writing.
+  Profile *profile = dent->out.profile;
+  pipeline->timed = profile != NULL;
+  pipeline->readTime = pipeline->writeTime = 0;
+  dent->out.profile = NULL;
+  dent->out.sink = passOn;
+  dent->out.context = pipeline;
+
+  pthread_t reader, writer;
+  startStage(&reader, readInput, pipeline);
+  startStage(&writer, writeOutput, pipeline);
+
+  Block block;
+  bool whole = true;
+  while (take(&pipeline->input.full, &block)) {
+    DentStatus status = dentFeed(dent, block.data, block.len);
+    put(&pipeline->input.empty, block);
+    if (status != DentOk) {
+      whole = false;
+      break;
+    }
+  }
+  if (whole) {
+    dentFinish(dent);
+  }
+
+  // Once the writer has written everything, the state can have its own sink back.
+  closeQueue(&pipeline->output.full);
+  pthread_join(writer, NULL);
+  dent->out.sink = pipeline->sink;
+  dent->out.context = pipeline->context;
+  dent->out.profile = profile;
+
+  // Output handed to the writer last may have failed after the state thought it was written.
+  if (pipeline->failed && !dent->out.failed) {
+    dent->out.failed = true;
+    dent->out.error = pipeline->error;
+    if (dent->status == DentOk) {
+      dent->status = DentFailed;
+    }
+  }
+  if (profile) {
+    profile->writeTime += pipeline->writeTime;
+  }
+
+  // If indenting stopped early, the reader may be waiting for input, so it's woken up.
+  if (!whole && write(pipeline->wake[1], "", 1) != 1) {
+    perror("write");
+    exit(EXIT_FAILURE);
+  }
+  closeQueue(&pipeline->input.empty);
+  pthread_join(reader, NULL);
+  close(pipeline->wake[0]);
+  close(pipeline->wake[1]);
+  if (profile) {
+    profile->readTime += pipeline->readTime;
+  }
+  freeLink(&pipeline->input);
+  freeLink(&pipeline->output);
+  free(pipeline);
+  return dent->status;
+}
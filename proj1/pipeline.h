@@ -0,0 +1,33 @@
+/**
+   @file pipeline.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the pipeline.c component, which indents a stream with reading,
+   indenting and writing overlapped on three threads, passing blocks between them.
+ */
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include "dentlib.h"
+
+/** Number of bytes in each block passed between the stages of the pipeline. */
+#define PIPE_BLOCK 262144
+
+/** Number of blocks between each pair of stages, so one can be filled while another is used. */
+#define PIPE_DEPTH 4
+
+/**
+   Feed everything that can be read from the given file descriptor to the given state and finish it,
+   like indentStream(), but with a reader thread filling the next block of input while this thread
+   indents the current one, and a writer thread handing the block before to the state's sink.
+   Output goes through the writer thread until this returns; by then all of it has been handed
+   to the sink, and the state hands output to its sink directly again.
+   Exits the program if the input can't be read.
+   @param dent state to indent with.
+   @param fd file descriptor to read from.
+   @return how indenting the input turned out.
+ */
+DentStatus indentPipelined(DentState *dent, int fd);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+   @file policy.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Indentation policies for dent.  Building a policy fills in a table of the indentation
+   for every kind of line at every depth, so indenting a line is just a lookup.
+ */
+
+#include "policy.h"
+#include <string.h>
+#include <ctype.h>
+
+/** Characters that leave a line unfinished, so the next line is a continuation of it. */
+#define CONTINUING "([=+-*&|?"
+
+Prefix makePrefix(Policy const *policy, LineKind kind, int depth)
+{
+  if (kind == LineLabel && policy->outdentLabels && depth > 0) {
+    depth--;
+  }
+  int columns = depth * policy->width;
+  if (kind == LineContinued) {
+    columns += policy->continuation;
+  }
+
+  Prefix prefix = { 0, columns };
+  if (policy->tabs) {
+    prefix.tabs = columns / TAB_WIDTH;
+    prefix.spaces = columns % TAB_WIDTH;
+  }
+  return prefix;
+}
+
+void initPolicy(Policy *policy, int width, bool tabs, int continuation, bool outdentLabels)
+{
+  memset(policy, 0, sizeof(Policy));
+  policy->width = width;
+  policy->tabs = tabs;
+  policy->continuation = continuation;
+  policy->outdentLabels = outdentLabels;
+  policy->id = width | tabs << 7 | outdentLabels << 8 | continuation << 9;
+
+  for (char const *c = CONTINUING; continuation && *c; c++) {
+    policy->continues[(unsigned char) *c] = true;
+  }
+  for (int k = 0; k < LINE_KINDS; k++) {
+    for (int d = 0; d < PREFIX_DEPTH; d++) {
+      policy->prefix[k][d] = makePrefix(policy, k, d);
+    }
+  }
+}
+
+/**
+   Return true if the given text starts with the given word, as a whole word.
+   @param text text to check.
+   @param len number of bytes of text available.
+   @param word word to look for.
+   @return true if the text starts with the word.
+ */
+static bool startsWord(char const *text, size_t len, char const *word)
+{
+  size_t n = strlen(word);
+  return len >= n && strncmp(text, word, n) == 0
+    && (len == n || !(isalnum((unsigned char) text[n]) || text[n] == '_'));
+}
+
+bool isLabel(char const *text, size_t len)
+{
+  if (startsWord(text, len, "case")) {
+    return true;
+  }
+  if (!startsWord(text, len, "default")) {
+    return false;
+  }
+
+  // Only default followed by a colon is a label.
+  size_t i = strlen("default");
+  while (i < len && (text[i] == ' ' || text[i] == '\t')) {
+    i++;
+  }
+  return i < len && text[i] == ':';
+}
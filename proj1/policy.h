@@ -0,0 +1,102 @@
+/**
+   @file policy.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the policy.c component, with the indentation policies dent can follow:
+   how wide each level is, whether tabs are used, how much a continued line is indented,
+   and whether case labels are pulled back to the level of their switch.
+   The indentation for each kind of line at each depth is worked out ahead of time.
+ */
+
+#ifndef _POLICY_H_
+#define _POLICY_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/** Default number of columns for each level of indentation. */
+#define DEFAULT_WIDTH 2
+
+/** Columns a tab advances to the next multiple of. */
+#define TAB_WIDTH 8
+
+/** Largest indentation width or continuation indent a policy can have. */
+#define MAX_WIDTH 64
+
+/** Number of depths the indentation is worked out ahead of time for. */
+#define PREFIX_DEPTH 256
+
+/** Kinds of lines that are indented differently. */
+typedef enum {
+  /** An ordinary line, indented by its depth. */
+  LineNormal,
+
+  /** A line following one that ends with an operator or an open parenthesis. */
+  LineContinued,
+
+  /** A line starting with a case or default label. */
+  LineLabel
+} LineKind;
+
+/** Number of kinds of lines in LineKind. */
+#define LINE_KINDS 3
+
+/** Indentation for the start of a line, as a number of tabs followed by a number of spaces. */
+typedef struct {
+  int tabs;
+  int spaces;
+} Prefix;
+
+/** How lines are indented. */
+typedef struct {
+  /** Number saved in checkpoint indexes, so an index is only used with the policy that made it. */
+  int id;
+
+  /** Number of columns for each level of indentation. */
+  int width;
+
+  /** True if indentation uses as many tabs as it can, followed by spaces. */
+  bool tabs;
+
+  /** Extra columns for a continued line, or zero to indent them like any other line. */
+  int continuation;
+
+  /** True if case and default labels are indented one level less than the rest of their switch. */
+  bool outdentLabels;
+
+  /** Whether a line ending in each character is continued on the next line. */
+  bool continues[256];
+
+  /** Indentation for each kind of line at each depth below PREFIX_DEPTH. */
+  Prefix prefix[LINE_KINDS][PREFIX_DEPTH];
+} Policy;
+
+/**
+   Set up the given policy, working out its indentation ahead of time.
+   @param policy policy to set up.
+   @param width number of columns for each level of indentation.
+   @param tabs true to indent with tabs as far as possible.
+   @param continuation extra columns for a continued line.
+   @param outdentLabels true to pull case and default labels back one level.
+ */
+void initPolicy(Policy *policy, int width, bool tabs, int continuation, bool outdentLabels);
+
+/**
+   Work out the indentation for a line of the given kind at the given depth,
+   for depths too deep to have been worked out ahead of time.
+   @param policy policy to follow.
+   @param kind kind of the line.
+   @param depth the indentation depth.
+   @return indentation for the line.
+ */
+Prefix makePrefix(Policy const *policy, LineKind kind, int depth);
+
+/**
+   Return true if the given text starts with a case or default label.
+   @param text start of the line, after its leading whitespace.
+   @param len number of bytes of the line that are available.
+   @return true if the line is a label in a switch.
+ */
+bool isLabel(char const *text, size_t len);
+
+#endif
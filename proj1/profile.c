@@ -0,0 +1,89 @@
+/**
+   @file profile.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Counters for profiling the input dent indents, and the report it prints from them.
+ */
+
+#include "profile.h"
+#include <string.h>
+#include <time.h>
+
+void initProfile(Profile *profile)
+{
+  memset(profile, 0, sizeof(Profile));
+}
+
+double profileClock()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void countLength(Profile *profile, long long length)
+{
+  int bucket = length ? 64 - __builtin_clzll(length) : 0;
+  profile->lengths[bucket < LENGTH_BUCKETS ? bucket : LENGTH_BUCKETS - 1]++;
+  if (length > profile->longest) {
+    profile->longest = length;
+  }
+  profile->lines++;
+}
+
+void finishProfile(Profile *profile)
+{
+  if (profile->bytes > profile->lineBegin) {
+    countLength(profile, profile->bytes - profile->lineBegin);
+    profile->lineBegin = profile->bytes;
+  }
+}
+
+void mergeProfile(Profile *total, Profile const *part)
+{
+  total->bytes += part->bytes;
+  total->lines += part->lines;
+  total->blank += part->blank;
+  for (int k = 0; k < LENGTH_BUCKETS; k++) {
+    total->lengths[k] += part->lengths[k];
+  }
+  if (part->longest > total->longest) {
+    total->longest = part->longest;
+  }
+  total->indented += part->indented;
+  total->depthSum += part->depthSum;
+  if (part->maxDepth > total->maxDepth) {
+    total->maxDepth = part->maxDepth;
+  }
+  total->literalBytes += part->literalBytes;
+  total->readTime += part->readTime;
+  total->scanTime += part->scanTime;
+  total->writeTime += part->writeTime;
+}
+
+void printProfile(FILE *fp, Profile const *profile)
+{
+  fprintf(fp, "bytes: %lld\n", profile->bytes);
+  fprintf(fp, "lines: %lld (%lld blank)\n", profile->lines, profile->blank);
+  fprintf(fp, "longest line: %lld bytes\n", profile->longest);
+  fprintf(fp, "line lengths:\n");
+  for (int k = 0; k < LENGTH_BUCKETS; k++) {
+    if (profile->lengths[k] == 0) {
+      continue;
+    }
+    long long low = k ? 1LL << (k - 1) : 0;
+    if (k == LENGTH_BUCKETS - 1) {
+      fprintf(fp, "  %10lld+           %12lld\n", low, profile->lengths[k]);
+    }
+    else {
+      fprintf(fp, "  %10lld-%-10lld %12lld\n", low, k ? (1LL << k) - 1 : 0,
+              profile->lengths[k]);
+    }
+  }
+  fprintf(fp, "depth: max %d, mean %.2f\n", profile->maxDepth,
+          profile->indented ? (double) profile->depthSum / profile->indented : 0.0);
+  fprintf(fp, "literal bytes: %lld (%.1f%%)\n", profile->literalBytes,
+          profile->bytes ? 100.0 * profile->literalBytes / profile->bytes : 0.0);
+  fprintf(fp, "time: read %.6f s, scan %.6f s, write %.6f s\n",
+          profile->readTime, profile->scanTime, profile->writeTime);
+}
@@ -0,0 +1,95 @@
+/**
+   @file profile.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the profile.c component, with the counters dent keeps
+   when it's asked for a profile of its input, and the report it prints from them.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdio.h>
+
+/**
+   Number of buckets in the histogram of line lengths.  Bucket 0 counts empty lines,
+   and bucket k counts lines from 2^(k-1) up to 2^k - 1 bytes long, with the last one
+   counting everything longer.
+ */
+#define LENGTH_BUCKETS 32
+
+/** Counters describing the input dent indented and where its time went. */
+typedef struct {
+  /** Number of bytes of input indented. */
+  long long bytes;
+
+  /** Number of lines, and how many of those were blank. */
+  long long lines;
+  long long blank;
+
+  /** Histogram of line lengths in bytes, not counting the newline. */
+  long long lengths[LENGTH_BUCKETS];
+
+  /** Length of the longest line. */
+  long long longest;
+
+  /** Offset in the input of the start of the current line. */
+  long long lineBegin;
+
+  /** Number of lines that were indented, and the total of their depths. */
+  long long indented;
+  long long depthSum;
+
+  /** Deepest nesting reached. */
+  int maxDepth;
+
+  /** Bytes copied literally, inside strings, character literals and block comments. */
+  long long literalBytes;
+
+  /** Seconds spent reading input, indenting it, and writing output. */
+  double readTime;
+  double scanTime;
+  double writeTime;
+} Profile;
+
+/**
+   Clear all the counters in the given profile.
+   @param profile profile to clear.
+ */
+void initProfile(Profile *profile);
+
+/**
+   Return the time on a monotonic clock, for timing the phases of indenting.
+   @return the time in seconds.
+ */
+double profileClock();
+
+/**
+   Count a line of the given length.
+   @param profile profile to count the line in.
+   @param length length of the line in bytes.
+ */
+void countLength(Profile *profile, long long length);
+
+/**
+   Count the last line of the input, if it doesn't end with a newline.
+   @param profile profile at the end of the input.
+ */
+void finishProfile(Profile *profile);
+
+/**
+   Add the counters from one profile into another,
+   for input that was indented in pieces.
+   @param total profile to add to.
+   @param part profile to add.
+ */
+void mergeProfile(Profile *total, Profile const *part);
+
+/**
+   Print a report from the given profile.
+   @param fp stream to print the report to.
+   @param profile profile to report.
+ */
+void printProfile(FILE *fp, Profile const *profile);
+
+#endif
@@ -0,0 +1,402 @@
+/**
+   @file raster.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Classifying the pixels of a pie chart.  Coordinates are measured in half pixels from the center,
+   so they're whole numbers and squared distances are exact.  A pixel is past a slice boundary if
+   it's in the upper half of the plane and the boundary isn't, or if they're in the same half and
+   the cross product of the boundary's direction with the pixel's offset is positive.
+   Only when the cross product is too close to zero for its sign to be trusted is the angle
+   worked out with atan2(), so every pixel gets exactly the class the angle comparison would give it.
+   Along a row, the angle only ever goes one way, so each boundary splits the row in two,
+   and the row is filled in as runs between the points where it's crossed.  Where each row crosses
+   the circles is kept in a mask for the size, so a chart only has to find its boundaries.
+   Anti-aliasing looks at the runs of pixels within half a pixel of an edge, and shares each
+   of those out between the classes either side of the edge by its signed distance from it.
+ */
+
+#include "raster.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/** Cross products closer to zero than this, relative to the distance, are checked with atan2(). */
+#define TIE 1e-9
+
+void initChart(Chart *chart, Geometry const *geometry, int const *sizes, int slices)
+{
+  chart->geometry = geometry;
+  chart->slices = slices;
+
+  long long total = 0;
+  for (int k = 0; k < slices; k++) {
+    total += sizes[k];
+  }
+  long long partial = 0;
+  chart->lower = 0;
+  for (int k = 0; k < slices - 1; k++) {
+    partial += sizes[k];
+    Boundary *b = &chart->bound[k];
+    b->angle = 2*PI*((double) partial)/((double) total)-PI;
+    b->dx = cos(b->angle);
+    b->dy = sin(b->angle);
+    b->upper = b->angle >= 0;
+    if (!b->upper) {
+      chart->lower++;
+    }
+  }
+}
+
+/**
+   Return true if the angle of a pixel is past the given boundary.
+   @param b boundary to compare against.
+   @param x pixel's X offset from the center, in half pixels.
+   @param y pixel's Y offset from the center, in half pixels.
+   @return true if atan2() gives the pixel a greater angle than the boundary.
+ */
+static bool pastBoundary(Boundary const *b, double x, double y)
+{
+  bool upper = y >= 0;
+  if (upper != b->upper) {
+    return upper;
+  }
+  double cross = b->dx * y - b->dy * x;
+  if (fabs(cross) > TIE * (fabs(x) + fabs(y))) {
+    return cross > 0;
+  }
+  return atan2(y / 2, x / 2) > b->angle;
+}
+
+/**
+   Return the columns of a row that are inside a circle around the center.
+   @param size width of the row.
+   @param r2 squared radius of the circle, in half pixels.
+   @param y row's Y offset from the center, in half pixels.
+   @return the columns inside the circle, which may be empty.
+ */
+static Span spanOf(int size, double r2, double y)
+{
+  Span span = { 0, 0 };
+  double room = r2 - y * y;
+  if (room < 0) {
+    return span;
+  }
+
+  // The square root is only an estimate; the exact test settles the last half pixel.
+  double reach = floor(sqrt(room));
+  while ((reach + 1) * (reach + 1) <= room) {
+    reach++;
+  }
+  while (reach * reach > room) {
+    reach--;
+  }
+
+  // Column c is at 2c + 1 - size half pixels, so these are the columns within reach.
+  long long low = (long long) ceil((size - 1 - reach) / 2);
+  long long high = (long long) floor((size - 1 + reach) / 2);
+  span.begin = low < 0 ? 0 : low;
+  span.end = high >= size ? size : high + 1;
+  if (span.end < span.begin) {
+    span.end = span.begin;
+  }
+  return span;
+}
+
+bool initGeometry(Geometry *geometry, int size)
+{
+  int radius = (size * PIE_RADIUS + SIZE / 2) / SIZE;
+  int border = (size * BORDER + SIZE / 2) / SIZE;
+  geometry->size = size;
+  geometry->inner = 4.0 * radius * radius;
+  geometry->outer = 4.0 * (radius + border) * (radius + border);
+  geometry->innerRadius = radius;
+  geometry->outerRadius = radius + border;
+  geometry->rows = malloc(size * sizeof(RowMask));
+  if (!geometry->rows) {
+    return false;
+  }
+  for (int y = 0; y < size; y++) {
+    double cy = 2 * y + 1 - size;
+    geometry->rows[y].border = spanOf(size, geometry->outer, cy);
+    geometry->rows[y].pie = spanOf(size, geometry->inner, cy);
+  }
+  return true;
+}
+
+void freeGeometry(Geometry *geometry)
+{
+  free(geometry->rows);
+}
+
+/**
+   Find where a row crosses a boundary.  Along a row in the lower half of the plane the angle
+   grows from left to right, and in the upper half it shrinks, so the pixels past the boundary
+   are all on one side.  The crossing is estimated from where the boundary's ray meets the row,
+   then moved until it agrees with pastBoundary().
+   @param chart chart the row is in.
+   @param b boundary the row crosses.
+   @param y row's Y offset from the center, in half pixels.
+   @param span columns of the row to look in.
+   @return the first column of the span on the right side of the crossing.
+ */
+static int crossing(Chart const *chart, Boundary const *b, double y, Span span)
+{
+  bool upper = y >= 0;
+  double x0 = 1 - chart->geometry->size;
+  double at = b->dy != 0 ? ((y * b->dx / b->dy) - x0) / 2 : span.begin;
+  int c = at < span.begin ? span.begin : at > span.end ? span.end : (int) ceil(at);
+
+  // Right of the crossing, pixels are past the boundary in the lower half and not in the upper.
+  while (c > span.begin && pastBoundary(b, x0 + 2 * (c - 1), y) != upper) {
+    c--;
+  }
+  while (c < span.end && pastBoundary(b, x0 + 2 * c, y) == upper) {
+    c++;
+  }
+  return c;
+}
+
+/**
+   Fill in the slices for the part of a row inside the pie.
+   @param chart chart to classify the pixels of.
+   @param y row's Y offset from the center, in half pixels.
+   @param span columns of the row inside the pie.
+   @param row row of classes to fill in.
+ */
+static void fillSlices(Chart const *chart, double y, Span span, unsigned char *row)
+{
+  // Boundaries in the other half of the plane are either all passed or none are.
+  bool upper = y >= 0;
+  int passed = upper ? chart->lower : 0;
+  int first = passed;
+  int last = upper ? chart->slices - 1 : chart->lower;
+
+  // In the lower half, each boundary crossed from left to right is one more passed.
+  // In the upper half, it's one fewer, so the row is filled from the right instead.
+  int from = upper ? span.end : span.begin;
+  for (int k = first; k <= last; k++) {
+    int to = k < last ? crossing(chart, &chart->bound[k], y, span) : upper ? span.begin : span.end;
+    if (upper && to < from) {
+      memset(row + to, PIXEL_SLICE + passed, from - to);
+      from = to;
+    }
+    else if (!upper && to > from) {
+      memset(row + from, PIXEL_SLICE + passed, to - from);
+      from = to;
+    }
+    passed++;
+  }
+}
+
+void classifyRow(Chart const *chart, int y, unsigned char *row)
+{
+  Geometry const *geometry = chart->geometry;
+  double cy = 2 * y + 1 - geometry->size;
+  memset(row, PIXEL_BACKGROUND, geometry->size);
+  Span outer = geometry->rows[y].border;
+  memset(row + outer.begin, PIXEL_BORDER, outer.end - outer.begin);
+  Span inner = geometry->rows[y].pie;
+  if (inner.end > inner.begin) {
+    fillSlices(chart, cy, inner, row);
+  }
+}
+
+/**
+   Return the columns of a row within half a pixel of a circle around the center, on either side.
+   @param size width of the row.
+   @param radius radius of the circle, in pixels.
+   @param y row's Y offset from the center, in half pixels.
+   @param spans set to the columns, which may be split into a run on each side of the center.
+   @return the number of runs.
+ */
+static int ringSpans(int size, double radius, double y, Span *spans)
+{
+  Span out = spanOf(size, (2 * radius + 1) * (2 * radius + 1), y);
+  if (out.end <= out.begin) {
+    return 0;
+  }
+  Span in = { 0, 0 };
+  if (radius >= 0.5) {
+    in = spanOf(size, (2 * radius - 1) * (2 * radius - 1), y);
+  }
+  if (in.end <= in.begin) {
+    spans[0] = out;
+    return 1;
+  }
+  spans[0] = (Span) { out.begin, in.begin };
+  spans[1] = (Span) { in.end, out.end };
+  return 2;
+}
+
+/**
+   Return the columns of a row within half a pixel of the line through a slice edge.
+   @param size width of the row.
+   @param dx X part of the edge's direction.
+   @param dy Y part of the edge's direction.
+   @param y row's Y offset from the center, in half pixels.
+   @param pie columns of the row the pie covers any part of.
+   @return the columns near the edge, which may be empty.
+ */
+static Span rayColumns(int size, double dx, double dy, double y, Span pie)
+{
+  Span span = { 0, 0 };
+  if (y * dy < 0) {
+    // The row only meets the line on the far side of the center from the edge.
+    return span;
+  }
+  if (dy == 0) {
+    return fabs(dx * y) < 1 ? pie : span;
+  }
+
+  // The distance from the line is |dx * y - dy * x| in half pixels.
+  double low = (dx * y - 1) / dy;
+  double high = (dx * y + 1) / dy;
+  if (low > high) {
+    double t = low;
+    low = high;
+    high = t;
+  }
+  double begin = ceil((low + size - 1) / 2);
+  double end = floor((high + size - 1) / 2) + 1;
+  span.begin = begin < pie.begin ? pie.begin : begin > pie.end ? pie.end : (int) begin;
+  span.end = end > pie.end ? pie.end : end < span.begin ? span.begin : (int) end;
+  return span;
+}
+
+/**
+   Return the direction of the given slice edge.  The first slices - 1 edges are the boundaries;
+   the last is the negative X axis, where the last slice meets the first.
+   @param chart chart the edge is in.
+   @param k index of the edge.
+   @param dx set to the X part of the direction.
+   @param dy set to the Y part of the direction.
+ */
+static void edgeDirection(Chart const *chart, int k, double *dx, double *dy)
+{
+  if (k < chart->slices - 1) {
+    *dx = chart->bound[k].dx;
+    *dy = chart->bound[k].dy;
+  }
+  else {
+    *dx = -1;
+    *dy = 0;
+  }
+}
+
+int edgeSpans(Chart const *chart, int y, Span *spans)
+{
+  Geometry const *geometry = chart->geometry;
+  double cy = 2 * y + 1 - geometry->size;
+  int count = ringSpans(geometry->size, geometry->outerRadius, cy, spans);
+  count += ringSpans(geometry->size, geometry->innerRadius, cy, spans + count);
+
+  double reach = 2 * geometry->innerRadius + 1;
+  Span pie = spanOf(geometry->size, reach * reach, cy);
+  if (pie.end <= pie.begin) {
+    return count;
+  }
+  for (int k = 0; k < chart->slices; k++) {
+    double dx, dy;
+    edgeDirection(chart, k, &dx, &dy);
+    Span span = rayColumns(geometry->size, dx, dy, cy, pie);
+    if (span.end > span.begin) {
+      spans[count++] = span;
+    }
+  }
+  return count;
+}
+
+/**
+   Return the slice a point is in, by the number of boundaries its angle is past.
+   @param chart chart the point is in.
+   @param x point's X offset from the center, in half pixels.
+   @param y point's Y offset from the center, in half pixels.
+   @return index of the slice.
+ */
+static int sliceAt(Chart const *chart, double x, double y)
+{
+  int slice = 0;
+  for (int k = 0; k < chart->slices - 1; k++) {
+    if (pastBoundary(&chart->bound[k], x, y)) {
+      slice++;
+    }
+  }
+  return slice;
+}
+
+/**
+   Return how much of a pixel is inside a circle, for a pixel whose center is the given distance
+   from the circle's center.
+   @param radius radius of the circle, in pixels.
+   @param distance distance of the pixel's center, in pixels.
+   @return the share of the pixel inside, from 0 to 1.
+ */
+static double coverage(double radius, double distance)
+{
+  double share = radius - distance + 0.5;
+  return share < 0 ? 0 : share > 1 ? 1 : share;
+}
+
+/**
+   Add a class to a blend, unless its share is nothing.
+   @param blend blend to add to.
+   @param class class to add.
+   @param share share of the pixel the class covers.
+ */
+static void addShare(Blend *blend, int class, double share)
+{
+  if (share > 0) {
+    blend->classes[blend->count] = class;
+    blend->shares[blend->count] = share;
+    blend->count++;
+  }
+}
+
+void blendPixel(Chart const *chart, int y, int c, Blend *blend)
+{
+  Geometry const *geometry = chart->geometry;
+  double cx = 2 * c + 1 - geometry->size;
+  double cy = 2 * y + 1 - geometry->size;
+  double distance = sqrt(cx * cx + cy * cy) / 2;
+  double outer = coverage(geometry->outerRadius, distance);
+  double inner = coverage(geometry->innerRadius, distance);
+
+  blend->count = 0;
+  addShare(blend, PIXEL_BACKGROUND, 1 - outer);
+  addShare(blend, PIXEL_BORDER, outer - inner);
+  if (inner <= 0) {
+    return;
+  }
+
+  // Find the nearest slice edge on the same side of the center as the pixel.
+  double nearest = 1;
+  double nx = 0, ny = 0;
+  for (int k = 0; k < chart->slices; k++) {
+    double dx, dy;
+    edgeDirection(chart, k, &dx, &dy);
+    double cross = dx * cy - dy * cx;
+    if (dx * cx + dy * cy >= 0 && fabs(cross) < fabs(nearest)) {
+      nearest = cross;
+      nx = -dy;
+      ny = dx;
+    }
+  }
+
+  if (fabs(nearest) >= 1) {
+    addShare(blend, PIXEL_SLICE + sliceAt(chart, cx, cy), inner);
+    return;
+  }
+
+  // The side of the edge the angle grows toward is covered by the slice just past it,
+  // and the other side by the slice just before it.
+  double fx = cx - nearest * nx, fy = cy - nearest * ny;
+  int ahead = PIXEL_SLICE + sliceAt(chart, fx + nx / 4, fy + ny / 4);
+  int behind = PIXEL_SLICE + sliceAt(chart, fx - nx / 4, fy - ny / 4);
+  if (ahead == behind) {
+    addShare(blend, ahead, inner);
+  }
+  else {
+    addShare(blend, ahead, inner * (0.5 + nearest / 2));
+    addShare(blend, behind, inner * (0.5 - nearest / 2));
+  }
+}
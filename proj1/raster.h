@@ -0,0 +1,174 @@
+/**
+   @file raster.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the raster.c component, which works out what each pixel of a pie chart is:
+   the background, the border, or one of the slices.  Each row is filled in as runs: the span
+   inside the border and the span inside the pie come from solving the circle equations for the row,
+   and the slice boundaries are crossed at most once each along it.  The circles only depend on
+   the size of the image, so their runs are worked out once for a size and shared by its charts.
+   For anti-aliased charts, it also finds the pixels near an edge and how much of each class
+   covers them, so only those pixels cost more to draw.
+ */
+
+#ifndef _RASTER_H_
+#define _RASTER_H_
+
+#include <stdbool.h>
+
+/** The default size of the image, 100 pixels by 100 pixels. */
+#define SIZE 100
+
+/** Largest size of image that can be drawn. */
+#define MAX_SIZE 65536
+
+/** The pie chart will be drawn in a circle of radius 45, for an image of the default size. */
+#define PIE_RADIUS 45
+
+/** The pie chart will have a 3-pixel border around it, for an image of the default size. */
+#define BORDER 3
+
+/** A mathematical constant. The ratio of a circle's circumference to its diameter. */
+#define PI 3.14159265358979
+
+/** Largest number of slices a chart can have. */
+#define MAX_SLICES 64
+
+/** Class of a pixel outside the border. */
+#define PIXEL_BACKGROUND 0
+
+/** Class of a pixel in the border. */
+#define PIXEL_BORDER 1
+
+/** Class of a pixel in the first slice; the class of a pixel in slice k is PIXEL_SLICE + k. */
+#define PIXEL_SLICE 2
+
+/** Largest number of runs of columns in a row that can be near an edge. */
+#define MAX_EDGES (MAX_SLICES + 4)
+
+/** Largest number of classes a pixel near an edge can be blended from. */
+#define BLEND_CLASSES 4
+
+/** A run of columns in a row, from begin up to but not including end. */
+typedef struct {
+  int begin;
+  int end;
+} Span;
+
+/** The classes covering a pixel near an edge, and the share of the pixel each one covers. */
+typedef struct {
+  int count;
+  unsigned char classes[BLEND_CLASSES];
+  double shares[BLEND_CLASSES];
+} Blend;
+
+/** Boundary between one slice and the next, a ray from the center of the chart. */
+typedef struct {
+  /** Angle of the ray, as atan2() would give for a point on it. */
+  double angle;
+
+  /** Direction of the ray, a unit vector. */
+  double dx;
+  double dy;
+
+  /** True if the angle is zero or more, so the ray is in the half of the plane with y >= 0. */
+  bool upper;
+} Boundary;
+
+/** The runs of columns in a row inside the outside of the border, and inside the pie. */
+typedef struct {
+  Span border;
+  Span pie;
+} RowMask;
+
+/**
+   Everything about a chart that depends only on the size of its image, so it can be worked out
+   once and shared by every chart of that size.
+ */
+typedef struct {
+  /** Width and height of the image. */
+  int size;
+
+  /**
+     Squared radii of the pie and of the outside of its border, scaled by four so they can be
+     compared with squared distances measured in half pixels.
+   */
+  double inner;
+  double outer;
+
+  /** Radii of the pie and of the outside of its border, in pixels. */
+  double innerRadius;
+  double outerRadius;
+
+  /** The circles as a run-length mask, with the runs for each row. */
+  RowMask *rows;
+} Geometry;
+
+/** Everything needed to classify the pixels of one chart. */
+typedef struct {
+  /** Geometry of the image the chart is drawn in. */
+  Geometry const *geometry;
+
+  /** Number of slices, and the boundaries between them, in order. */
+  int slices;
+  Boundary bound[MAX_SLICES - 1];
+
+  /** Number of boundaries in the lower half of the plane, which come first. */
+  int lower;
+} Chart;
+
+/**
+   Work out the geometry for an image of the given size, with the radius and border scaled
+   to match, and the runs of each row inside them.
+   @param geometry geometry to set up.
+   @param size width and height of the image, from 1 to MAX_SIZE.
+   @return false if there isn't enough memory for the mask.
+ */
+bool initGeometry(Geometry *geometry, int size);
+
+/**
+   Free the memory used by the given geometry.
+   @param geometry geometry to free.
+ */
+void freeGeometry(Geometry *geometry);
+
+/**
+   Set up the given chart for an image with the given geometry, and slices of the given
+   relative sizes, and work out the boundaries between them.
+   @param chart chart to set up.
+   @param geometry geometry of the image, which must outlast the chart.
+   @param sizes relative sizes of the slices, none negative and not all zero.
+   @param slices number of slices, at most MAX_SLICES.
+ */
+void initChart(Chart *chart, Geometry const *geometry, int const *sizes, int slices);
+
+/**
+   Work out the class of each pixel in a row of the chart.
+   @param chart chart to classify the pixels of.
+   @param y the row, counting from the top.
+   @param row set to the class of each pixel in the row, chart->size of them.
+ */
+void classifyRow(Chart const *chart, int y, unsigned char *row);
+
+/**
+   Find the runs of columns in a row that are within half a pixel of an edge, either side of
+   the border or a boundary between two slices.  Only these pixels are partly covered
+   by more than one class, so anti-aliasing them is enough.  The runs may overlap.
+   @param chart chart the row is in.
+   @param y the row, counting from the top.
+   @param spans set to the runs, at most MAX_EDGES of them.
+   @return the number of runs.
+ */
+int edgeSpans(Chart const *chart, int y, Span *spans);
+
+/**
+   Work out how much of a pixel each class covers, from its distance to the circles and to
+   the nearest slice boundary.  A pixel no edge passes through is covered by its class alone.
+   @param chart chart the pixel is in.
+   @param y the pixel's row, counting from the top.
+   @param c the pixel's column, counting from the left.
+   @param blend set to the classes covering the pixel and their shares, which add up to one.
+ */
+void blendPixel(Chart const *chart, int y, int c, Blend *blend);
+
+#endif
@@ -0,0 +1,170 @@
+/**
+   @file scan.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Classification kernels that find the characters from a small set in a block of input,
+   a portable scalar one and SSE2 and AVX2 ones chosen at run time.
+ */
+
+#include "scan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+/** Defined when the vector kernels can be compiled on this architecture. */
+#define HAVE_X86 1
+#endif
+
+void initScanSet(ScanSet *set, char const *chars)
+{
+  memset(set, 0, sizeof(ScanSet));
+  for (; *chars && set->count < SET_LIMIT; chars++) {
+    set->chars[set->count++] = *chars;
+    set->member[(unsigned char) *chars] = true;
+  }
+}
+
+/**
+   Classify a chunk one byte at a time.
+   @param chunk SCAN_CHUNK bytes of input.
+   @param set characters to look for.
+   @return mask of the characters from the set in the chunk.
+ */
+static uint64_t classifyScalar(char const *chunk, ScanSet const *set)
+{
+  uint64_t mask = 0;
+  for (int i = 0; i < SCAN_CHUNK; i++) {
+    if (set->member[(unsigned char) chunk[i]]) {
+      mask |= (uint64_t) 1 << i;
+    }
+  }
+  return mask;
+}
+
+#ifdef HAVE_X86
+
+/**
+   Classify a chunk sixteen bytes at a time with SSE2,
+   comparing all four pieces of the chunk against each character of the set in turn.
+   @param chunk SCAN_CHUNK bytes of input.
+   @param set characters to look for.
+   @return mask of the characters from the set in the chunk.
+ */
+__attribute__((target("sse2")))
+static uint64_t classifySSE2(char const *chunk, ScanSet const *set)
+{
+  __m128i v0 = _mm_loadu_si128((__m128i const *) chunk);
+  __m128i v1 = _mm_loadu_si128((__m128i const *) (chunk + 16));
+  __m128i v2 = _mm_loadu_si128((__m128i const *) (chunk + 32));
+  __m128i v3 = _mm_loadu_si128((__m128i const *) (chunk + 48));
+  __m128i h0 = _mm_setzero_si128();
+  __m128i h1 = h0, h2 = h0, h3 = h0;
+  for (int k = 0; k < set->count; k++) {
+    __m128i ch = _mm_set1_epi8(set->chars[k]);
+    h0 = _mm_or_si128(h0, _mm_cmpeq_epi8(v0, ch));
+    h1 = _mm_or_si128(h1, _mm_cmpeq_epi8(v1, ch));
+    h2 = _mm_or_si128(h2, _mm_cmpeq_epi8(v2, ch));
+    h3 = _mm_or_si128(h3, _mm_cmpeq_epi8(v3, ch));
+  }
+  return (uint64_t) (uint16_t) _mm_movemask_epi8(h0)
+    | (uint64_t) (uint16_t) _mm_movemask_epi8(h1) << 16
+    | (uint64_t) (uint16_t) _mm_movemask_epi8(h2) << 32
+    | (uint64_t) (uint16_t) _mm_movemask_epi8(h3) << 48;
+}
+
+/**
+   Classify a chunk thirty-two bytes at a time with AVX2,
+   comparing both halves of the chunk against each character of the set in turn.
+   @param chunk SCAN_CHUNK bytes of input.
+   @param set characters to look for.
+   @return mask of the characters from the set in the chunk.
+ */
+__attribute__((target("avx2")))
+static uint64_t classifyAVX2(char const *chunk, ScanSet const *set)
+{
+  __m256i v0 = _mm256_loadu_si256((__m256i const *) chunk);
+  __m256i v1 = _mm256_loadu_si256((__m256i const *) (chunk + 32));
+  __m256i h0 = _mm256_setzero_si256();
+  __m256i h1 = h0;
+  for (int k = 0; k < set->count; k++) {
+    __m256i ch = _mm256_set1_epi8(set->chars[k]);
+    h0 = _mm256_or_si256(h0, _mm256_cmpeq_epi8(v0, ch));
+    h1 = _mm256_or_si256(h1, _mm256_cmpeq_epi8(v1, ch));
+  }
+  return (uint64_t) (uint32_t) _mm256_movemask_epi8(h0)
+    | (uint64_t) (uint32_t) _mm256_movemask_epi8(h1) << 32;
+}
+
+#endif
+
+/** Kernel used by findInSet(), the scalar one until chooseScanner() picks another. */
+static ClassifyFunc classify = classifyScalar;
+
+char const *chooseScanner()
+{
+  char const *want = getenv("DENT_SCAN");
+
+#ifdef HAVE_X86
+  __builtin_cpu_init();
+  if ((!want || strcmp(want, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+    classify = classifyAVX2;
+    return "avx2";
+  }
+  if ((!want || strcmp(want, "sse2") == 0 || strcmp(want, "avx2") == 0)
+      && __builtin_cpu_supports("sse2")) {
+    classify = classifySSE2;
+    return "sse2";
+  }
+#endif
+
+  classify = classifyScalar;
+  return "scalar";
+}
+
+size_t findInSet(char const *buf, size_t len, ScanSet const *set)
+{
+  size_t i = 0;
+  for (; i + SCAN_CHUNK <= len; i += SCAN_CHUNK) {
+    uint64_t mask = classify(buf + i, set);
+    if (mask) {
+      return i + __builtin_ctzll(mask);
+    }
+  }
+
+  // Whatever is left is shorter than a chunk.
+  for (; i < len; i++) {
+    if (set->member[(unsigned char) buf[i]]) {
+      return i;
+    }
+  }
+  return len;
+}
+
+size_t findNext(ScanCache *cache, char const *buf, size_t len, ScanSet const *set)
+{
+  size_t i = 0;
+  if (cache->set == set && buf >= cache->chunk && buf < cache->chunk + SCAN_CHUNK) {
+    uint64_t mask = cache->mask >> (buf - cache->chunk);
+    if (mask) {
+      return __builtin_ctzll(mask);
+    }
+    i = cache->chunk + SCAN_CHUNK - buf;
+  }
+
+  for (; i + SCAN_CHUNK <= len; i += SCAN_CHUNK) {
+    uint64_t mask = classify(buf + i, set);
+    if (mask) {
+      cache->chunk = buf + i;
+      cache->set = set;
+      cache->mask = mask;
+      return i + __builtin_ctzll(mask);
+    }
+  }
+  for (; i < len; i++) {
+    if (set->member[(unsigned char) buf[i]]) {
+      return i;
+    }
+  }
+  return len;
+}
@@ -0,0 +1,93 @@
+/**
+   @file scan.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the scan.c component, with functions for finding the next
+   character from a small set (the characters that can change dent's state)
+   in a block of input, using vector instructions when the processor has them.
+ */
+
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Number of bytes classified by one call to a classification kernel. */
+#define SCAN_CHUNK 64
+
+/** Largest number of characters in a set the scanner can look for. */
+#define SET_LIMIT 8
+
+/** A set of characters the scanner can look for. */
+typedef struct {
+  /** Number of characters in the set. */
+  int count;
+
+  /** The characters in the set, for the vector kernels. */
+  char chars[SET_LIMIT];
+
+  /** Whether each byte value is in the set, for the scalar kernel. */
+  bool member[256];
+} ScanSet;
+
+/**
+   The classification of the last chunk a search stopped in,
+   so the searches that follow in the same chunk don't have to classify it again.
+   A cache is only good for one block of input; it has to be cleared for the next.
+ */
+typedef struct {
+  /** Start of the chunk, or NULL if nothing has been classified yet. */
+  char const *chunk;
+
+  /** Set the chunk was classified against. */
+  ScanSet const *set;
+
+  /** Mask of the characters from the set in the chunk. */
+  uint64_t mask;
+} ScanCache;
+
+/**
+   A classification kernel.  Given a pointer to SCAN_CHUNK bytes of input,
+   it returns a mask with bit i set if byte i is in the given set.
+ */
+typedef uint64_t (*ClassifyFunc)(char const *chunk, ScanSet const *set);
+
+/**
+   Initialize the given set to contain the characters of the given string.
+   @param set set to initialize.
+   @param chars characters for the set, at most SET_LIMIT of them.
+ */
+void initScanSet(ScanSet *set, char const *chars);
+
+/**
+   Choose the classification kernel to use for the rest of the program.
+   By default this picks the widest one the processor supports,
+   but the DENT_SCAN environment variable can force scalar, sse2 or avx2.
+   @return name of the kernel that was chosen.
+ */
+char const *chooseScanner();
+
+/**
+   Return the index of the first character in the given block that's in the given set,
+   or len if there isn't one.
+   @param buf block of input to search.
+   @param len number of bytes in the block.
+   @param set characters to look for.
+   @return index of the first character from the set.
+ */
+size_t findInSet(char const *buf, size_t len, ScanSet const *set);
+
+/**
+   Just like findInSet(), but reusing the classification of the chunk
+   the last search with the given cache stopped in, when this search starts inside it.
+   @param cache classification of the last chunk, updated for this search.
+   @param buf block of input to search.
+   @param len number of bytes in the block.
+   @param set characters to look for.
+   @return index of the first character from the set.
+ */
+size_t findNext(ScanCache *cache, char const *buf, size_t len, ScanSet const *set);
+
+#endif
@@ -0,0 +1,115 @@
+#!/bin/bash
+# Benchmark dent and pie, and write the results to a CSV file.
+#
+# For each corpus size and kind from corpus.sh, every dent variant is run
+# once for timing and once more under measure -s to count its system
+# calls.  The scalar, sse2 and avx2 kernels read the corpus through a
+# pipe, since a regular file on standard input is memory-mapped; the mmap
+# variant times that path.  The scalar kernel compares every byte the way
+# the original implementation did, so it's the baseline for the others.
+# The pipe and async variants read through a pipe, without and with -a.
+# If OLD_DENT names an older dent, it's run the same way as the kernels,
+# and the speed of each variant against it is printed.  pie is timed on
+# the test inputs.
+#
+# Environment:
+#   SIZES      corpus sizes in MB (default "1 100 1024")
+#   KINDS      corpus kinds (default "mixed nested long strings blank")
+#   CSV        file for the results (default bench.csv)
+#   BASELINE   earlier CSV to compare against; any row whose throughput
+#              dropped by more than THRESHOLD percent (default 10) is
+#              reported, and the script exits with status 1
+#   OLD_DENT   an older dent to compare against (default none)
+#   DENT, PIE, MEASURE   programs to run
+
+DENT=${DENT:-./dent}
+PIE=${PIE:-./pie}
+MEASURE=${MEASURE:-./test/measure}
+SIZES=${SIZES:-1 100 1024}
+KINDS=${KINDS:-mixed nested long strings blank}
+CSV=${CSV:-bench.csv}
+THRESHOLD=${THRESHOLD:-10}
+DIR=$(dirname "$0")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+echo "tool,variant,corpus,size_mb,bytes,wall_s,mb_per_s,peak_rss_kb,syscalls,status" > "$CSV"
+
+# Run one variant of a tool, and add a row for it.
+# usage: record tool variant corpus size_mb source stdin command [argument ...]
+# The throughput is the size of the source file over the wall time,
+# or the size of the output if the source is -.
+record() {
+  TOOL=$1 VARIANT=$2 CORPUS=$3 SIZE=$4 SOURCE=$5 STDIN=$6
+  shift 6
+  OUT=/dev/null
+  if [ "$SOURCE" = - ]; then
+    OUT="$WORK/out"
+  fi
+  "$MEASURE" -o "$WORK/time" "$@" < "$STDIN" > "$OUT"
+  STATUS=$?
+  BYTES=$(wc -c < "${SOURCE/#-/$OUT}")
+  rm -f "$WORK/out"
+  "$MEASURE" -s -o "$WORK/calls" "$@" < "$STDIN" > /dev/null
+  read WALL RSS IGNORE < "$WORK/time"
+  read IGNORE IGNORE CALLS < "$WORK/calls"
+  awk -v t="$TOOL" -v v="$VARIANT" -v c="$CORPUS" -v s="$SIZE" -v b="$BYTES" \
+      -v w="$WALL" -v r="$RSS" -v n="$CALLS" -v st="$STATUS" 'BEGIN {
+    mbs = w > 0 ? b / 1048576 / w : 0
+    printf "%s,%s,%s,%s,%d,%.6f,%.1f,%d,%d,%d\n", t, v, c, s, b, w, mbs, r, n, st >> ENVIRON["CSV"]
+    printf "%-5s %-8s %-8s %6s MB %8.3f s %9.1f MB/s %8d KB %8d calls\n", t, v, c, s, w, mbs, r, n
+  }'
+}
+export CSV
+
+for SIZE in $SIZES; do
+  for KIND in $KINDS; do
+    INPUT="$WORK/$KIND.txt"
+    bash "$DIR/corpus.sh" "$KIND" "$SIZE" > "$INPUT" || exit 1
+    if [ -n "$OLD_DENT" ]; then
+      record dent old "$KIND" "$SIZE" "$INPUT" /dev/null sh -c 'cat "$1" | "$2"' sh "$INPUT" "$OLD_DENT"
+    fi
+    for KERNEL in scalar sse2 avx2; do
+      DENT_SCAN=$KERNEL record dent "$KERNEL" "$KIND" "$SIZE" "$INPUT" /dev/null \
+          sh -c 'cat "$1" | "$2"' sh "$INPUT" "$DENT"
+    done
+    record dent mmap "$KIND" "$SIZE" "$INPUT" /dev/null "$DENT" "$INPUT"
+    record dent j4 "$KIND" "$SIZE" "$INPUT" "$INPUT" "$DENT" -j 4
+    record dent c "$KIND" "$SIZE" "$INPUT" "$INPUT" "$DENT" -c
+    record dent pipe "$KIND" "$SIZE" "$INPUT" /dev/null sh -c 'cat "$1" | "$2"' sh "$INPUT" "$DENT"
+    record dent async "$KIND" "$SIZE" "$INPUT" /dev/null sh -c 'cat "$1" | "$2" -a' sh "$INPUT" "$DENT"
+    rm -f "$INPUT"
+    if [ -n "$OLD_DENT" ]; then
+      awk -F, -v c="$KIND" -v s="$SIZE" '
+        $1 == "dent" && $3 == c && $4 == s { mbs[$2] = $7; order[n++] = $2 }
+        END {
+          for (i = 0; i < n; i++) {
+            v = order[i]
+            if (v != "old" && mbs["old"] > 0) {
+              printf "dent  %-8s %-8s %6s MB %8.2fx old\n", v, c, s, mbs[v] / mbs["old"]
+            }
+          }
+        }' "$CSV"
+    fi
+  done
+done
+
+for INPUT in "$DIR"/input_p[1-4].txt; do
+  NAME=$(basename "$INPUT" .txt)
+  record pie p3 "$NAME" 0 - "$INPUT" "$PIE"
+done
+
+# Compare throughput against the baseline, row by row.
+if [ -n "$BASELINE" ]; then
+  awk -F, -v limit="$THRESHOLD" '
+    FNR == 1 { next }
+    NR == FNR { base[$1 "," $2 "," $3 "," $4] = $7; next }
+    {
+      key = $1 "," $2 "," $3 "," $4
+      if ((key in base) && base[key] > 0 && $7 < base[key] * (1 - limit / 100)) {
+        printf "regression: %s %.1f MB/s, was %.1f MB/s\n", key, $7, base[key]
+        slow = 1
+      }
+    }
+    END { exit slow }' "$BASELINE" "$CSV" || exit 1
+fi
@@ -0,0 +1,88 @@
+#!/bin/bash
+# Write a deterministic synthetic input for dent to standard output.
+#
+# usage: corpus.sh kind size_mb
+#
+# Kinds:
+#   mixed    nested blocks of ordinary statements with short strings
+#   nested   brackets nested hundreds of levels deep
+#   long     very long lines with brackets scattered through them
+#   strings  huge string literals spanning many lines, full of brackets
+#   blank    mostly blank and whitespace-only lines
+#
+# Every kind has matched brackets, so dent should exit successfully on it.
+
+KIND=${1:-mixed}
+SIZE_MB=${2:-1}
+
+awk -v kind="$KIND" -v limit=$((SIZE_MB * 1024 * 1024)) '
+function emit(line) {
+  print line
+  bytes += length(line) + 1
+}
+
+BEGIN {
+  bytes = 0
+  if (kind !~ /^(mixed|nested|long|strings|blank)$/) {
+    print "corpus.sh: unknown kind " kind > "/dev/stderr"
+    exit 1
+  }
+
+  # Build the pieces that repeat once, so generating a large corpus is quick.
+  pad = "    result = compute(alpha, beta, gamma, delta, \"a { string }\");"
+  long = ""
+  for (i = 0; i < 512; i++) {
+    long = long sprintf("call%d(x, { %d, %d }); ", i, i, i * 7)
+  }
+
+  while (bytes < limit) {
+    if (kind == "mixed") {
+      for (d = 0; d < 8; d++) {
+        emit(sprintf("%*sif (value%d > %d) {", d, "", d, d))
+      }
+      for (i = 0; i < 16; i++) {
+        emit(pad)
+      }
+      emit("")
+      for (d = 7; d >= 0; d--) {
+        emit(sprintf("%*s}", d, ""))
+      }
+    }
+    else if (kind == "nested") {
+      for (d = 0; d < 400; d++) {
+        emit(sprintf("%*sblock%d {", d % 8, "", d))
+      }
+      emit("x = 1;")
+      for (d = 399; d >= 0; d--) {
+        emit(sprintf("%*s}", d % 8, ""))
+      }
+    }
+    else if (kind == "long") {
+      emit("void f() {")
+      for (i = 0; i < 4; i++) {
+        emit("\t" long)
+      }
+      emit("}")
+    }
+    else if (kind == "strings") {
+      emit("char *s = \"begin {")
+      for (i = 0; i < 256; i++) {
+        emit("   } this { is all { inside } the string } {{ ")
+      }
+      emit("end\";")
+      emit("if (x) {")
+      emit("  y = \"{\";")
+      emit("}")
+    }
+    else {
+      emit("if (x) {")
+      for (i = 0; i < 64; i++) {
+        emit("")
+        emit("        \t  ")
+        emit("   \t")
+      }
+      emit("  y();")
+      emit("}")
+    }
+  }
+}'
@@ -0,0 +1,192 @@
+/**
+   @file feed.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   This program checks the streaming interface of the dent library, for the test script.
+   It reads its standard input, then indents it with two states at once, taking turns feeding
+   one of them a byte at a time and the other pieces of random sizes.  If the two come out the
+   same, it writes the output and exits the way dent would; otherwise it reports the difference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "../dentlib.h"
+
+/** Exit status for unmatched brackets, the same as dent's. */
+#define EXIT_UNSUCCESS 100
+
+/** Exit status when the two states don't agree. */
+#define EXIT_MISMATCH 2
+
+/** Largest piece fed to the state that gets pieces of random sizes. */
+#define MAX_PIECE 4096
+
+/** Output collected from one state. */
+typedef struct {
+  /** The bytes, how many there are and how many there's room for. */
+  char *data;
+  size_t len;
+  size_t cap;
+} Collected;
+
+/** A state being fed, where its text is coming from and what it's produced. */
+typedef struct {
+  /** The state. */
+  DentState *state;
+
+  /** Number of bytes of the input fed to it so far. */
+  size_t pos;
+
+  /** True if it's fed a byte at a time rather than random pieces. */
+  bool bytewise;
+
+  /** Output handed to its sink. */
+  Collected out;
+
+  /** How indenting turned out, once it's finished. */
+  DentStatus status;
+} Feeder;
+
+/**
+   Add some bytes to the end of a growing buffer, exiting if there's no memory for them.
+   @param buffer buffer to add to.
+   @param buf bytes to add.
+   @param len number of bytes to add.
+ */
+static void append(Collected *buffer, char const *buf, size_t len)
+{
+  if (len == 0) {
+    return;
+  }
+  if (buffer->len + len > buffer->cap) {
+    buffer->cap = buffer->cap * 2 + len;
+    buffer->data = realloc(buffer->data, buffer->cap);
+    if (!buffer->data) {
+      perror("feed");
+      exit(EXIT_FAILURE);
+    }
+  }
+  memcpy(buffer->data + buffer->len, buf, len);
+  buffer->len += len;
+}
+
+/**
+   Sink for each state, collecting its output.
+   @param context the Collected buffer.
+   @param buf block of output.
+   @param len number of bytes in the block.
+   @return true, since collecting can't fail.
+ */
+static bool collect(void *context, char const *buf, size_t len)
+{
+  append(context, buf, len);
+  return true;
+}
+
+/**
+   Feed the next piece of the input to a state, and finish it at the end of the input.
+   @param feeder the state being fed.
+   @param text the whole input.
+   @param len length of the input.
+   @return false once the state has been finished, or has stopped early.
+ */
+static bool feedNext(Feeder *feeder, char const *text, size_t len)
+{
+  size_t piece = feeder->bytewise ? 1 : 1 + rand() % MAX_PIECE;
+  if (piece > len - feeder->pos) {
+    piece = len - feeder->pos;
+  }
+  if (piece > 0 && dentFeed(feeder->state, text + feeder->pos, piece) != DentOk) {
+    feeder->status = feeder->state->status;
+    return false;
+  }
+  feeder->pos += piece;
+  if (feeder->pos == len) {
+    feeder->status = dentFinish(feeder->state);
+    return false;
+  }
+  return true;
+}
+
+/**
+   Starting point for the program.  With -c, comments and character literals are understood
+   as in C, and with -s, the random piece sizes come from the given seed.
+   @param argc the number of command-line arguments.
+   @param argv command-line arguments.
+   @return exit status for the program.
+ */
+int main(int argc, char *argv[])
+{
+  DentOptions options;
+  dentDefaults(&options);
+  unsigned seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "cs:")) != -1) {
+    if (opt == 'c') {
+      options.cSyntax = true;
+    }
+    else if (opt == 's') {
+      seed = strtoul(optarg, NULL, 10);
+    }
+    else {
+      fprintf(stderr, "usage: feed [-c] [-s seed]\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  srand(seed);
+
+  Collected input = { NULL, 0, 0 };
+  char buf[MAX_PIECE];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) {
+    append(&input, buf, n);
+  }
+
+  Feeder feeders[2];
+  for (int i = 0; i < 2; i++) {
+    feeders[i].pos = 0;
+    feeders[i].bytewise = i == 0;
+    feeders[i].out = (Collected) { NULL, 0, 0 };
+    feeders[i].status = DentOk;
+    feeders[i].state = dentCreate(&options, collect, &feeders[i].out);
+    if (!feeders[i].state) {
+      perror("feed");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Take turns until both states are done, the first a byte at a time, the second a piece.
+  bool busy[2] = { true, true };
+  while (busy[0] || busy[1]) {
+    for (int i = 0; i < 2; i++) {
+      if (busy[i]) {
+        busy[i] = feedNext(&feeders[i], input.data, input.len);
+      }
+    }
+  }
+
+  Collected *a = &feeders[0].out;
+  Collected *b = &feeders[1].out;
+  if (feeders[0].status != feeders[1].status || a->len != b->len ||
+      (a->len && memcmp(a->data, b->data, a->len) != 0)) {
+    fprintf(stderr, "feed: byte-at-a-time and random pieces disagree\n");
+    exit(EXIT_MISMATCH);
+  }
+  if (a->len) {
+    fwrite(a->data, 1, a->len, stdout);
+  }
+  int status = EXIT_SUCCESS;
+  if (feeders[0].status == DentUnmatched) {
+    printf("Unmatched brackets\n");
+    status = EXIT_UNSUCCESS;
+  }
+  for (int i = 0; i < 2; i++) {
+    dentFree(feeders[i].state);
+    free(feeders[i].out.data);
+  }
+  free(input.data);
+  return status;
+}
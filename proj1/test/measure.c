@@ -0,0 +1,202 @@
+/**
+   @file measure.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   This program runs a command and reports how long it took, the most memory it used,
+   and, optionally, how many system calls it made, for the benchmark script.
+   The command's standard input and output are left alone, so they can be redirected
+   as usual, and the measurements are written to a separate file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/** Exit status when the command couldn't be run or measured. */
+#define EXIT_MEASURE 125
+
+/** Largest number of threads and processes whose system calls can be followed at once. */
+#define TRACE_LIMIT 1024
+
+/** A thread being traced, and whether it's stopped inside a system call. */
+typedef struct {
+  /** Thread id. */
+  pid_t tid;
+
+  /** True between the stop at the entry to a system call and the stop at its exit. */
+  bool inCall;
+} Traced;
+
+/**
+   Return the current time on the monotonic clock in seconds.
+   @return current time in seconds.
+ */
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+   Find the entry for the given thread, adding one if it's new.
+   @param list threads seen so far.
+   @param count number of threads in the list, updated if one is added.
+   @param tid thread to look for.
+   @return entry for the thread, or NULL if the list is full.
+ */
+static Traced *findTraced(Traced *list, int *count, pid_t tid)
+{
+  for (int i = 0; i < *count; i++) {
+    if (list[i].tid == tid) {
+      return list + i;
+    }
+  }
+  if (*count == TRACE_LIMIT) {
+    return NULL;
+  }
+  list[*count].tid = tid;
+  list[*count].inCall = false;
+  return list + (*count)++;
+}
+
+/**
+   Follow a traced child, and every thread and process it starts, until it exits,
+   counting the system calls they make.  Each call stops the thread twice,
+   once on the way in and once on the way out, and only the first is counted.
+   @param child process to follow, stopped just before it runs the command.
+   @param status exit status of the child, filled in when it exits.
+   @return number of system calls made.
+ */
+static long long countCalls(pid_t child, int *status)
+{
+  static Traced list[TRACE_LIMIT];
+  int count = 0;
+  long long calls = 0;
+
+  ptrace(PTRACE_SETOPTIONS, child, 0, PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE
+         | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_EXITKILL);
+  ptrace(PTRACE_SYSCALL, child, 0, 0);
+
+  for (;;) {
+    int st;
+    pid_t tid = waitpid(-1, &st, __WALL);
+    if (tid < 0) {
+      return calls;
+    }
+    if (WIFEXITED(st) || WIFSIGNALED(st)) {
+      if (tid == child) {
+        *status = st;
+      }
+      continue;
+    }
+
+    int sig = 0;
+    if (WSTOPSIG(st) == (SIGTRAP | 0x80)) {
+      Traced *t = findTraced(list, &count, tid);
+      if (t) {
+        t->inCall = !t->inCall;
+        calls += t->inCall;
+      }
+    }
+    else if (WSTOPSIG(st) != SIGTRAP && WSTOPSIG(st) != SIGSTOP) {
+      // Pass real signals on to the command.
+      sig = WSTOPSIG(st);
+    }
+    ptrace(PTRACE_SYSCALL, tid, 0, sig);
+  }
+}
+
+/**
+   Print a usage message and exit.
+ */
+static void usage()
+{
+  fprintf(stderr, "usage: measure [-s] [-o file] command [argument ...]\n");
+  exit(EXIT_MEASURE);
+}
+
+/**
+   Starting point for the program.  It runs the command given by its arguments,
+   then writes its wall time in seconds, its peak resident set size in kilobytes
+   and the number of system calls it made (or -1 without -s) on one line,
+   to standard error or to the file given with -o.
+   Counting system calls slows the command down, so it's best done in a separate run.
+   @param argc the number of command-line arguments.
+   @param argv command-line arguments.
+   @return exit status of the command.
+ */
+int main(int argc, char *argv[])
+{
+  bool trace = false;
+  char const *report = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "+so:")) != -1) {
+    if (opt == 's') {
+      trace = true;
+    }
+    else if (opt == 'o') {
+      report = optarg;
+    }
+    else {
+      usage();
+    }
+  }
+  if (optind == argc) {
+    usage();
+  }
+
+  double start = now();
+  pid_t child = fork();
+  if (child < 0) {
+    perror("fork");
+    return EXIT_MEASURE;
+  }
+  if (child == 0) {
+    if (trace) {
+      ptrace(PTRACE_TRACEME, 0, 0, 0);
+      raise(SIGSTOP);
+    }
+    execvp(argv[optind], argv + optind);
+    perror(argv[optind]);
+    _exit(EXIT_MEASURE);
+  }
+
+  int status = 0;
+  long long calls = -1;
+  if (trace) {
+    // Wait for the child to stop itself, so the tracing options can be set.
+    waitpid(child, &status, 0);
+    calls = countCalls(child, &status);
+  }
+  else {
+    waitpid(child, &status, 0);
+  }
+  double wall = now() - start;
+
+  struct rusage usage;
+  getrusage(RUSAGE_CHILDREN, &usage);
+
+  FILE *fp = report ? fopen(report, "w") : stderr;
+  if (!fp) {
+    perror(report);
+    return EXIT_MEASURE;
+  }
+  fprintf(fp, "%.6f %ld %lld\n", wall, usage.ru_maxrss, calls);
+  if (fp != stderr) {
+    fclose(fp);
+  }
+
+  if (WIFSIGNALED(status)) {
+    return 128 + WTERMSIG(status);
+  }
+  return WEXITSTATUS(status);
+}
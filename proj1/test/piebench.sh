@@ -0,0 +1,100 @@
+#!/bin/bash
+# Benchmark pie's binary renderers at a range of image sizes and thread
+# counts, and write the results to a CSV file.
+#
+# Every combination of size, thread count and format is drawn once, with
+# the image thrown away, and its wall time and peak RSS are measured.
+# Throughput is given in megapixels per second.  Then each size and format
+# is drawn as a batch of one chart and a batch of REPEAT charts, to compare
+# the first chart, which lays out the image and the geometry for its size,
+# with the warm ones after it, which reuse them.  Last, the P3 text format
+# is timed from 100 pixels to 4K, against an older pie if OLD_PIE names one.
+#
+# Environment:
+#   PIE_SIZES  image sizes in pixels (default "100 1000 4000 8000 16000")
+#   THREADS    thread counts (default "1 2 4 8")
+#   FORMATS    formats (default "p6 png")
+#   SLICES     slice sizes to draw (default "3 1 4 1 5 9 2 6")
+#   CSV        file for the results (default piebench.csv)
+#   REPEAT     charts in the warm batch (default 10)
+#   WARM_CSV   file for the first and warm times (default piewarm.csv)
+#   P3_SIZES   image sizes for P3 (default "100 1000 2000 4000")
+#   OLD_PIE    an older pie to compare P3 times against (default none)
+#   P3_CSV     file for the P3 times (default piep3.csv)
+#   PIE, MEASURE   programs to run
+
+PIE=${PIE:-./pie}
+MEASURE=${MEASURE:-./test/measure}
+PIE_SIZES=${PIE_SIZES:-100 1000 4000 8000 16000}
+THREADS=${THREADS:-1 2 4 8}
+FORMATS=${FORMATS:-p6 png}
+SLICES=${SLICES:-3 1 4 1 5 9 2 6}
+CSV=${CSV:-piebench.csv}
+REPEAT=${REPEAT:-10}
+WARM_CSV=${WARM_CSV:-piewarm.csv}
+P3_SIZES=${P3_SIZES:-100 1000 2000 4000}
+P3_CSV=${P3_CSV:-piep3.csv}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+echo "$SLICES" > "$WORK/slices"
+COUNT=$(wc -w < "$WORK/slices")
+
+echo "size,threads,format,wall_s,mpix_per_s,peak_rss_kb,status" > "$CSV"
+for SIZE in $PIE_SIZES; do
+  for FORMAT in $FORMATS; do
+    for JOBS in $THREADS; do
+      "$MEASURE" -o "$WORK/time" "$PIE" -s "$SIZE" -n "$COUNT" -f "$FORMAT" -j "$JOBS" \
+        < "$WORK/slices" > /dev/null
+      STATUS=$?
+      read WALL RSS IGNORE < "$WORK/time"
+      awk -v s="$SIZE" -v j="$JOBS" -v f="$FORMAT" -v w="$WALL" -v r="$RSS" -v st="$STATUS" -v csv="$CSV" 'BEGIN {
+        mps = w > 0 ? s * s / 1e6 / w : 0
+        printf "%d,%d,%s,%.6f,%.1f,%d,%d\n", s, j, f, w, mps, r, st >> csv
+        printf "pie %6d px  %-3s  %3d threads  %8.3f s  %9.1f Mpixels/s  %8d KB\n", s, f, j, w, mps, r
+      }'
+    done
+  done
+done
+
+# A batch of different charts, so none of them could be served from anything kept.
+for i in $(seq "$REPEAT"); do
+  echo "$SLICES $i"
+done > "$WORK/batch"
+head -n 1 "$WORK/batch" > "$WORK/first"
+
+echo "size,format,first_s,warm_s" > "$WARM_CSV"
+for SIZE in $PIE_SIZES; do
+  for FORMAT in $FORMATS; do
+    "$MEASURE" -o "$WORK/time" "$PIE" -b -s "$SIZE" -f "$FORMAT" < "$WORK/first" > /dev/null
+    read FIRST RSS IGNORE < "$WORK/time"
+    "$MEASURE" -o "$WORK/time" "$PIE" -b -s "$SIZE" -f "$FORMAT" < "$WORK/batch" > /dev/null
+    read ALL RSS IGNORE < "$WORK/time"
+    awk -v s="$SIZE" -v f="$FORMAT" -v first="$FIRST" -v all="$ALL" -v n="$REPEAT" -v csv="$WARM_CSV" 'BEGIN {
+      warm = n > 1 ? (all - first) / (n - 1) : 0
+      printf "%d,%s,%.6f,%.6f\n", s, f, first, warm >> csv
+      printf "pie %6d px  %-3s  first %8.3f s  warm %8.3f s\n", s, f, first, warm
+    }'
+  done
+done
+
+echo "size,wall_s,old_wall_s,speedup" > "$P3_CSV"
+for SIZE in $P3_SIZES; do
+  "$MEASURE" -o "$WORK/time" "$PIE" -s "$SIZE" -n "$COUNT" < "$WORK/slices" > /dev/null
+  read WALL RSS IGNORE < "$WORK/time"
+  OLD=0
+  if [ -n "$OLD_PIE" ]; then
+    "$MEASURE" -o "$WORK/time" "$OLD_PIE" -s "$SIZE" -n "$COUNT" < "$WORK/slices" > /dev/null
+    read OLD RSS IGNORE < "$WORK/time"
+  fi
+  awk -v s="$SIZE" -v w="$WALL" -v o="$OLD" -v csv="$P3_CSV" 'BEGIN {
+    speedup = o > 0 && w > 0 ? o / w : 0
+    printf "%d,%.6f,%.6f,%.2f\n", s, w, o, speedup >> csv
+    if (o > 0) {
+      printf "pie %6d px  p3   %8.3f s  old %8.3f s  %6.2fx\n", s, w, o, speedup
+    }
+    else {
+      printf "pie %6d px  p3   %8.3f s\n", s, w
+    }
+  }'
+done
@@ -3,7 +3,7 @@ FAIL=0
 
 # make a fresh copy of the target programs
 make clean
-make
+make && make test/feed
 if [ $? -ne 0 ]; then
   echo "**** Make (compilation) FAILED"
   FAIL=1
@@ -42,6 +42,40 @@ testDent() {
   return 0
 }
 
+# Function to run the library's streaming interface against a dent test case,
+# fed a byte at a time and in random pieces by test/feed, and check it
+# behaves just like the dent program
+testFeed() {
+  TEST_NO=$1
+  ESTATUS=$2
+
+  rm -f output.txt
+
+  echo "Feed test $TEST_NO: test/feed -s $TEST_NO < input_d$TEST_NO.txt > output.txt"
+  test/feed -s $TEST_NO < input_d$TEST_NO.txt > output.txt
+  STATUS=$?
+
+  # Make sure the program exited with the right exit status.
+  if [ $STATUS -ne $ESTATUS ]
+  then
+      echo "**** Feed test $TEST_NO FAILED - incorrect exit status. Expected: $ESTATUS Got: $STATUS"
+      FAIL=1
+      return 1
+  fi
+
+  # Make sure the output matches the expected output.
+  diff -q expected_d$TEST_NO.txt output.txt >/dev/null 2>&1
+  if [ $? -ne 0 ]
+  then
+      echo "**** Feed test $TEST_NO FAILED - output didn't match the expected output"
+      FAIL=1
+      return 1
+  fi
+
+  echo "Feed test $TEST_NO PASS"
+  return 0
+}
+
 # Function to run the pie program against a test case and check its
 # output and exit status for correct behavior
 testPie() {
@@ -94,6 +128,13 @@ testDent 5 0
 testDent 6 100
 testDent 7 100
 
+# Test the library's streaming interface on the same cases.
+for TEST_NO in 1 2 3 4 5; do
+  testFeed $TEST_NO 0
+done
+testFeed 6 100
+testFeed 7 100
+
 # Test the pie program.
 testPie 1 0
 testPie 2 0
@@ -0,0 +1,260 @@
+/**
+   @file bits.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Bitset index for the cross program's word list.  Bit i of a group's bitsets stands for the
+   i-th word of that length, so the words come out of a match in the order of the word list.
+   The bitsets of a group are kept together in one array, and when a group fills up they're all
+   copied into one twice as long.  A pattern of nothing but ? matches every word of its length.
+   A group only gets bitsets once it has SPARSE_LIMIT words, which keeps their size in line with
+   the text of the words; before that, its words are compared with the pattern a letter at a time.
+ */
+
+#include "bits.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of bits in each block of a bitset. */
+#define BLOCK_BITS 64
+
+void initBits(BitIndex *index)
+{
+  index->groups = NULL;
+  index->count = 0;
+  index->capacity = 0;
+  index->fixed = NULL;
+  index->fixedCap = 0;
+}
+
+/**
+   Find where the group for words of the given length is, or would go.
+   @param index the index.
+   @param len length of word.
+   @return position of the first group for words at least that long.
+ */
+static int findGroup(BitIndex const *index, int len)
+{
+  int low = 0;
+  int high = index->count;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (index->groups[mid].length < len) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+   Return the group for words of the given length, adding an empty one if there isn't one.
+   Only lengths with words have groups, so a long word doesn't cost anything for the lengths
+   below it.
+   @param index the index.
+   @param len length of word.
+   @return the group, or NULL if there isn't enough memory for it.
+ */
+static BitGroup *makeGroup(BitIndex *index, int len)
+{
+  int pos = findGroup(index, len);
+  if (pos < index->count && index->groups[pos].length == len) {
+    return &index->groups[pos];
+  }
+  if (index->count == index->capacity) {
+    int capacity = index->capacity ? index->capacity * 2 : 16;
+    BitGroup *groups = realloc(index->groups, capacity * sizeof(BitGroup));
+    if (!groups) {
+      return NULL;
+    }
+    index->groups = groups;
+    index->capacity = capacity;
+  }
+  memmove(index->groups + pos + 1, index->groups + pos, (index->count - pos) * sizeof(BitGroup));
+  index->count++;
+  BitGroup *group = &index->groups[pos];
+  group->length = len;
+  group->count = 0;
+  group->members = NULL;
+  group->capacity = 0;
+  group->words = NULL;
+  group->blocks = 0;
+  group->sets = NULL;
+  return group;
+}
+
+/**
+   Double the number of words a group has room for, copying its bitsets into longer ones.
+   @param group group to grow.
+   @param len length of the group's words.
+   @return false if there isn't enough memory.
+ */
+static bool growGroup(BitGroup *group, int len)
+{
+  int blocks = group->blocks ? group->blocks * 2 : 1;
+  size_t sets = (size_t) len * ALPHABET;
+  uint64_t *bits = calloc(sets * blocks, sizeof(uint64_t));
+  if (!bits) {
+    return false;
+  }
+  for (size_t s = 0; group->blocks && s < sets; s++) {
+    memcpy(bits + s * blocks, group->sets + s * group->blocks, group->blocks * sizeof(uint64_t));
+  }
+  free(group->sets);
+  group->sets = bits;
+  group->blocks = blocks;
+  return true;
+}
+
+/**
+   Set the bits for one of a group's words, which there has to be room for.
+   @param group the group.
+   @param word the word.
+   @param len length of the word.
+   @param bit number of the word within the group.
+ */
+static void setBits(BitGroup *group, char const *word, int len, int bit)
+{
+  for (int p = 0; p < len; p++) {
+    uint64_t *set = group->sets + ((size_t) p * ALPHABET + word[p] - 'a') * group->blocks;
+    set[bit / BLOCK_BITS] |= (uint64_t) 1 << (bit % BLOCK_BITS);
+  }
+}
+
+bool addBits(BitIndex *index, char const *word, int wordIndex)
+{
+  int len = strlen(word);
+  BitGroup *group = makeGroup(index, len);
+  if (!group) {
+    return false;
+  }
+  if (group->count == group->capacity) {
+    int capacity = group->capacity ? group->capacity * 2 : 1;
+    int *members = realloc(group->members, capacity * sizeof(int));
+    if (!members) {
+      return false;
+    }
+    group->members = members;
+    if (!group->sets) {
+      char const **words = realloc(group->words, capacity * sizeof(char const *));
+      if (!words) {
+        return false;
+      }
+      group->words = words;
+    }
+    group->capacity = capacity;
+  }
+  int bit = group->count++;
+  group->members[bit] = wordIndex;
+
+  // Until the group is big enough for bitsets, the word is just kept for checking.
+  if (!group->sets && group->count < SPARSE_LIMIT) {
+    group->words[bit] = word;
+    return true;
+  }
+  if (group->count > group->blocks * BLOCK_BITS && !growGroup(group, len)) {
+    return false;
+  }
+  if (len > index->fixedCap) {
+    uint64_t const **fixed = realloc(index->fixed, len * sizeof(uint64_t const *));
+    if (!fixed) {
+      return false;
+    }
+    index->fixed = fixed;
+    index->fixedCap = len;
+  }
+  if (group->words) {
+    for (int i = 0; i < bit; i++) {
+      setBits(group, group->words[i], len, i);
+    }
+    free(group->words);
+    group->words = NULL;
+  }
+  setBits(group, word, len, bit);
+  return true;
+}
+
+int findBits(BitIndex const *index, char const *pat, int *found)
+{
+  int len = strlen(pat);
+  int pos = findGroup(index, len);
+  if (pos == index->count || index->groups[pos].length != len) {
+    return 0;
+  }
+  BitGroup const *group = &index->groups[pos];
+  int count = 0;
+  if (!group->sets) {
+    for (int i = 0; i < group->count; i++) {
+      int p = 0;
+      while (p < len && (pat[p] == '?' || pat[p] == group->words[i][p])) {
+        p++;
+      }
+      if (p == len) {
+        found[count++] = group->members[i];
+      }
+    }
+    return count;
+  }
+
+  // The bitsets for the pattern's letters, which every match has to be in.
+  uint64_t const **fixed = index->fixed;
+  int letters = 0;
+  for (int p = 0; p < len; p++) {
+    if (pat[p] != '?') {
+      fixed[letters++] = group->sets + ((size_t) p * ALPHABET + pat[p] - 'a') * group->blocks;
+    }
+  }
+
+  // With no letters, every word matches, up to the last one in the group.
+  int used = (group->count + BLOCK_BITS - 1) / BLOCK_BITS;
+  int tail = group->count % BLOCK_BITS;
+  for (int b = 0; b < used; b++) {
+    uint64_t bits = b == used - 1 && tail ? ((uint64_t) 1 << tail) - 1 : ~(uint64_t) 0;
+    for (int i = 0; i < letters && bits; i++) {
+      bits &= fixed[i][b];
+    }
+    while (bits) {
+      found[count++] = group->members[b * BLOCK_BITS + __builtin_ctzll(bits)];
+      bits &= bits - 1;
+    }
+  }
+  return count;
+}
+
+size_t bitsMemory(BitIndex const *index)
+{
+  size_t bytes = index->capacity * sizeof(BitGroup) + index->fixedCap * sizeof(uint64_t const *);
+  for (int g = 0; g < index->count; g++) {
+    BitGroup const *group = &index->groups[g];
+    size_t len = group->length;
+    bytes += (size_t) group->capacity * sizeof(int);
+    bytes += group->words ? group->capacity * sizeof(char const *) : 0;
+    bytes += len * ALPHABET * group->blocks * sizeof(uint64_t);
+  }
+  return bytes;
+}
+
+void countGroups(BitIndex const *index, int *bitsets, int *scanned)
+{
+  *bitsets = *scanned = 0;
+  for (int g = 0; g < index->count; g++) {
+    if (index->groups[g].sets) {
+      (*bitsets)++;
+    }
+    else {
+      (*scanned)++;
+    }
+  }
+}
+
+void freeBits(BitIndex *index)
+{
+  for (int g = 0; g < index->count; g++) {
+    free(index->groups[g].members);
+    free(index->groups[g].words);
+    free(index->groups[g].sets);
+  }
+  free(index->groups);
+  free(index->fixed);
+}
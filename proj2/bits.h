@@ -0,0 +1,106 @@
+/**
+   @file bits.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the bits.c component, an index of the word list for the cross program
+   made of bitsets.  The words of each length are numbered in the order they're added, and for
+   every position and letter there's a bitset of the words with that letter in that position.
+   A pattern is matched by ANDing together the bitsets for its letters, 64 words at a time.
+   A length with only a few words doesn't get bitsets, since they'd take 208 bytes for every
+   letter of the words; its words are checked one by one instead.
+ */
+
+#ifndef _BITS_H_
+#define _BITS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of letters a word can be made of. */
+#define ALPHABET 26
+
+/** Number of words of a length it takes for them to get bitsets. */
+#define SPARSE_LIMIT 64
+
+/** The bitsets for the words of one length. */
+typedef struct {
+  /** Length of the group's words. */
+  int length;
+
+  /** Number of words of this length, the index in the word list of each, and room for them. */
+  int count;
+  int *members;
+  int capacity;
+
+  /** Until there are SPARSE_LIMIT words, the text of each, or NULL once there are bitsets. */
+  char const **words;
+
+  /** Number of 64-bit blocks in each bitset. */
+  int blocks;
+
+  /** The bitsets, for each position in turn, and each letter within it, or NULL if none yet. */
+  uint64_t *sets;
+} BitGroup;
+
+/** Bitsets for a word list, in a group for each length of word. */
+typedef struct {
+  /** The groups, from the shortest words to the longest, how many there are and room for them. */
+  BitGroup *groups;
+  int count;
+  int capacity;
+
+  /** Room to list the bitsets for a pattern's letters, as long as the longest group's words. */
+  uint64_t const **fixed;
+  int fixedCap;
+} BitIndex;
+
+/**
+   Set up an empty index.
+   @param index index to set up.
+ */
+void initBits(BitIndex *index);
+
+/**
+   Add a word to the index.  Words have to be added in the order of the word list.
+   @param index index to add to.
+   @param word the word, of lowercase letters, which has to stay where it is while the
+   index is used.
+   @param wordIndex index of the word in the word list.
+   @return false if there isn't enough memory for it.
+ */
+bool addBits(BitIndex *index, char const *word, int wordIndex);
+
+/**
+   Find the words matching a pattern, where a ? matches any letter.
+   @param index index to look in.
+   @param pat the pattern.
+   @param found set to the indices of the matching words, in the order they were added.
+   It needs room for every word in the index.
+   @return the number of matching words.
+ */
+int findBits(BitIndex const *index, char const *pat, int *found);
+
+/**
+   Return the number of bytes of memory the index uses.
+   @param index the index.
+   @return its size in bytes.
+ */
+size_t bitsMemory(BitIndex const *index);
+
+/**
+   Count the word lengths the index has bitsets for, and the ones whose words are checked
+   one by one.
+   @param index the index.
+   @param bitsets set to the number of lengths with bitsets.
+   @param scanned set to the number of lengths with words but no bitsets.
+ */
+void countGroups(BitIndex const *index, int *bitsets, int *scanned);
+
+/**
+   Free the memory used by the given index.
+   @param index index to free.
+ */
+void freeBits(BitIndex *index);
+
+#endif
@@ -5,31 +5,90 @@
    This program reads a list of dictionary words,
    then helps users guess answers by showing users words of a particular length,
    that match characters they've already figured out.
+   The words are looked up in bitsets for each position and letter, or with -m trie, in a trie
+   for each length, with -m length, by checking the words of the pattern's length, or with
+   -m scan, by checking every word.
+   With -t, it reports how long the lookups took and how much memory the index uses.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include "trie.h"
+#include "bits.h"
 
-/** Each word in the file containing the word list may contain at most 20 letters. */
-#define LETTERS 20
+/** Number of bytes of the word file to make room for at first. */
+#define INITIAL_POOL 65536
 
-/** The file containing the word list may contain at most 100000 words. */
-#define WORDS 100000
+/** Where a word is kept in the pool, and how many letters it has. */
+typedef struct {
+  size_t offset;
+  int length;
+} Word;
 
-/** A two-dimensional array of characters for storing the word list. */
-char words[WORDS+1][LETTERS+1];
+/** The words of the word list, back to back, each with a null terminator after it. */
+char *pool;
+
+/** Each word in the pool, in the order of the word list. */
+Word *words;
 
 /** An integer representing the number of words on the word list. */
 int wordCount;
 
+/** Indices of the words grouped by length, keeping the order of the word list within a length.
+    The words of length len are byLength[lengthStart[len]] up to byLength[lengthStart[len + 1]]. */
+int *byLength;
+int *lengthStart;
+
+/** Length of the longest word. */
+int maxLength;
+
 /** Exit code for invalid input. */
 #define EXIT_UNSUCCESS 1
 
+/** Ways of finding the words that match a pattern. */
+typedef enum {
+  /** Check every word in the list. */
+  MethodScan,
+
+  /** Check the words of the pattern's length. */
+  MethodLength,
+
+  /** Walk the trie for the pattern's length. */
+  MethodTrie,
+
+  /** AND together the bitsets for the pattern's letters. */
+  MethodBits
+} Method;
+
+/**
+   Print a message about running out of memory and exit.
+ */
+void outOfMemory()
+{
+  fprintf(stderr, "Out of memory\n");
+  exit(EXIT_UNSUCCESS);
+}
+
+/**
+   Return one of the words on the word list.
+   @param i index of the word.
+   @return the word, with a null terminator.
+ */
+char const *wordAt(int i)
+{
+  return pool + words[i].offset;
+}
+
 /**
-   Read the word list from the file with the given name,
-   store it in the array words, and set wordCount.
+   Read the word list from the file with the given name into the pool, and set words,
+   wordCount, byLength, lengthStart and maxLength.  The whole file is read into the pool,
+   then its words are moved down over the spaces between them, so the pool never needs to be
+   bigger than the file.
    @param filename a pointer to a character.
  */
 void readWords(char const *filename)
@@ -39,75 +98,115 @@ void readWords(char const *filename)
     fprintf(stderr, "Can't open word file\n");
     exit(EXIT_UNSUCCESS);
   }
-  while (fscanf(fptr, "%s", words[wordCount]) == 1) {
-    if (words[wordCount][LETTERS]) {
-      fprintf(stderr, "Invalid word file\n");
-      exit(EXIT_UNSUCCESS);
+  size_t size = 0;
+  size_t capacity = 0;
+  while (true) {
+    if (size == capacity) {
+      capacity = capacity ? capacity * 2 : INITIAL_POOL;
+      pool = realloc(pool, capacity);
+      if (!pool) {
+        outOfMemory();
+      }
+    }
+    size_t len = fread(pool + size, 1, capacity - size, fptr);
+    if (len == 0) {
+      break;
+    }
+    size += len;
+  }
+  fclose(fptr);
+
+  // There's always room after the file for the last word's null terminator.
+  int wordCapacity = 0;
+  size_t out = 0;
+  maxLength = 0;
+  for (size_t in = 0; in < size; ) {
+    if (isspace((unsigned char) pool[in])) {
+      in++;
+      continue;
     }
-    for (int i = 0; words[wordCount][i]; i++) {
-      if (words[wordCount][i] < 'a' || words[wordCount][i] > 'z') {
+    size_t offset = out;
+    for ( ; in < size && !isspace((unsigned char) pool[in]); in++) {
+      if (pool[in] < 'a' || pool[in] > 'z') {
         fprintf(stderr, "Invalid word file\n");
         exit(EXIT_UNSUCCESS);
       }
+      pool[out++] = pool[in];
     }
-    wordCount++;
-    if (wordCount > WORDS) {
-      fprintf(stderr, "Invalid word file\n");
-      exit(EXIT_UNSUCCESS);
+    if (in < size) {
+      in++;
+    }
+    pool[out++] = '\0';
+    if (wordCount == wordCapacity) {
+      wordCapacity = wordCapacity ? wordCapacity * 2 : INITIAL_POOL / 8;
+      words = realloc(words, wordCapacity * sizeof(Word));
+      if (!words) {
+        outOfMemory();
+      }
+    }
+    words[wordCount].offset = offset;
+    words[wordCount].length = out - offset - 1;
+    if (words[wordCount].length > maxLength) {
+      maxLength = words[wordCount].length;
     }
+    wordCount++;
   }
-  fclose(fptr);
+  char *packed = realloc(pool, out ? out : 1);
+  pool = packed ? packed : pool;
+
+  // Count the words of each length, then place each after the words before it of that length.
+  byLength = malloc((wordCount + 1) * sizeof(int));
+  lengthStart = calloc(maxLength + 2, sizeof(int));
+  if (!byLength || !lengthStart) {
+    outOfMemory();
+  }
+  for (int i = 0; i < wordCount; i++) {
+    lengthStart[words[i].length + 1]++;
+  }
+  for (int len = 0; len <= maxLength; len++) {
+    lengthStart[len + 1] += lengthStart[len];
+  }
+  int *next = malloc((maxLength + 1) * sizeof(int));
+  if (!next) {
+    outOfMemory();
+  }
+  memcpy(next, lengthStart, (maxLength + 1) * sizeof(int));
+  for (int i = 0; i < wordCount; i++) {
+    byLength[next[words[i].length]++] = i;
+  }
+  free(next);
 }
 
 /**
-   Prompt the user for a pattern and stores it in the given array pat.
+   Prompt the user for a pattern, of any length, and return it.
    Detect and ignore invalid patterns and re-prompt the user until it gets a valid pattern.
-   Return true if the user (eventually) enters a valid pattern,
-   and false if it reaches end-of-file before getting a valid pattern.
-   @param pat a pointer to a character.
-   @return true if the user (eventually) enters a valid pattern,
-   and false if it reaches end-of-file before getting a valid pattern.
+   @return the pattern, which the caller frees, if the user (eventually) enters a valid pattern,
+   or NULL if it reaches end-of-file before getting a valid pattern.
  */
-bool getPattern(char *pat)
+char *getPattern()
 {
   printf("pattern> ");
-  for (int i = 0; i < LETTERS+1; i++) {
-    pat[i] = '\0';
-  }
-  while (scanf("%21s", pat) == 1) {
-    bool temp = false;
-    if (pat[LETTERS]) {
-      printf("Invalid pattern\n");
-      int ch = getchar();
-      while (ch != '\n') {
-        ch = getchar();
+  char *pat;
+  while (scanf("%ms", &pat) == 1) {
+    bool valid = true;
+    for (int i = 0; pat[i]; i++) {
+      if (pat[i] > 'z' || (pat[i] < 'a' && pat[i] != '?')) {
+        valid = false;
+        break;
       }
-      temp = true;
     }
-    else {
-      for (int i = 0; pat[i]; i++) {
-        if (pat[i] > 'z' || (pat[i] < 'a' && pat[i] != '?')) {
-          printf("Invalid pattern\n");
-          int ch = getchar();
-          while (ch != '\n') {
-            ch = getchar();
-          }
-          temp = true;
-          break;
-        }
-      }
+    if (valid) {
+      return pat;
     }
-    if (temp) {
-      for (int i = 0; i < LETTERS+1; i++) {
-        pat[i] = '\0';
-      }
-      printf("pattern> ");
-    }
-    else {
-      return true;
+    free(pat);
+    printf("Invalid pattern\n");
+    int ch = getchar();
+    while (ch != '\n' && ch != EOF) {
+      ch = getchar();
     }
+    printf("pattern> ");
   }
-  return false;
+  return NULL;
 }
 
 /**
@@ -130,30 +229,148 @@ bool matches(char const *word, char const *pat)
   return true;
 }
 
+/**
+   Return the time from a monotonic clock.
+   @return the time in seconds.
+ */
+double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+   Print out how to run the program and exit.
+ */
+void usage()
+{
+  fprintf(stderr, "usage: cross [-m scan|length|trie|bits] [-t] <word-file>\n");
+  exit(EXIT_UNSUCCESS);
+}
+
 /**
    Starting point for the program,
    it takes one command­-line argument, the name of a file containing the word list.
    The word list is a list of dictionary words this program is going to match against.
    The program will repeatedly prompt the user for patterns and report matches.
    It will terminate successfully when it reaches the end­-of-­file on standard input.
+   With -m, the words are found by the given method, and with -t, the time it took to
+   index the words and to find the matches is reported on standard error.
    @param argc the number of command-line arguments.
    @param argv command-line arguments.
    @return exit status for the program.
  */
 int main(int argc, char *argv[])
 {
-  if (argc != 2) {
-    fprintf(stderr, "usage: cross <word-file>\n");
-    exit(EXIT_UNSUCCESS);
+  Method method = MethodBits;
+  bool timing = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "m:t")) != -1) {
+    if (opt == 'm' && strcmp(optarg, "scan") == 0) {
+      method = MethodScan;
+    }
+    else if (opt == 'm' && strcmp(optarg, "length") == 0) {
+      method = MethodLength;
+    }
+    else if (opt == 'm' && strcmp(optarg, "trie") == 0) {
+      method = MethodTrie;
+    }
+    else if (opt == 'm' && strcmp(optarg, "bits") == 0) {
+      method = MethodBits;
+    }
+    else if (opt == 't') {
+      timing = true;
+    }
+    else {
+      usage();
+    }
   }
-  readWords(argv[1]);
-  char pat[LETTERS+1];
-  while (getPattern(pat)) {
-    for (int i = 0; i < wordCount; i++) {
-      if (matches(words[i], pat)) {
-        printf("%s\n", words[i]);
+  if (argc - optind != 1) {
+    usage();
+  }
+  readWords(argv[optind]);
+
+  double start = now();
+  Trie trie;
+  initTrie(&trie);
+  BitIndex bits;
+  initBits(&bits);
+  size_t memory = 0;
+  for (int i = 0; i < wordCount && (method == MethodTrie || method == MethodBits); i++) {
+    if (method == MethodTrie ? !addWord(&trie, wordAt(i), i) : !addBits(&bits, wordAt(i), i)) {
+      outOfMemory();
+    }
+  }
+  if (method == MethodTrie) {
+    memory = trieMemory(&trie);
+  }
+  else if (method == MethodBits) {
+    memory = bitsMemory(&bits);
+  }
+  if (timing) {
+    fprintf(stderr, "%d words indexed in %.3f ms, %zu bytes\n", wordCount,
+            (now() - start) * 1e3, memory);
+  }
+  if (timing && method == MethodBits) {
+    int bitsets, scanned;
+    countGroups(&bits, &bitsets, &scanned);
+    fprintf(stderr, "%d word lengths with bitsets, %d checked word by word\n", bitsets, scanned);
+  }
+
+  int *found = malloc((wordCount + 1) * sizeof(int));
+  if (!found) {
+    outOfMemory();
+  }
+  int patterns = 0;
+  long matched = 0;
+  double spent = 0;
+  char *pat;
+  while ((pat = getPattern())) {
+    start = now();
+    int count = 0;
+    size_t len = strlen(pat);
+    if (method == MethodScan) {
+      for (int i = 0; i < wordCount; i++) {
+        if (matches(wordAt(i), pat)) {
+          found[count++] = i;
+        }
       }
     }
+    else if (method == MethodLength) {
+      // Only the words of the pattern's length can match it.
+      int first = len <= (size_t) maxLength ? lengthStart[len] : 0;
+      int last = len <= (size_t) maxLength ? lengthStart[len + 1] : 0;
+      for (int j = first; j < last; j++) {
+        if (matches(wordAt(byLength[j]), pat)) {
+          found[count++] = byLength[j];
+        }
+      }
+    }
+    else if (method == MethodTrie) {
+      count = findWords(&trie, pat, found);
+    }
+    else {
+      count = findBits(&bits, pat, found);
+    }
+    spent += now() - start;
+    patterns++;
+    matched += count;
+    for (int i = 0; i < count; i++) {
+      printf("%s\n", wordAt(found[i]));
+    }
+    free(pat);
+  }
+  if (timing) {
+    fprintf(stderr, "%d patterns, %ld matches, %.3f us per pattern\n", patterns, matched,
+            patterns ? spent * 1e6 / patterns : 0.0);
   }
+  free(found);
+  freeTrie(&trie);
+  freeBits(&bits);
+  free(byLength);
+  free(lengthStart);
+  free(words);
+  free(pool);
   return EXIT_SUCCESS;
 }
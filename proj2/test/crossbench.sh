@@ -0,0 +1,54 @@
+#!/bin/bash
+# Benchmark cross's ways of finding the words that match a pattern, on the
+# same word list and the same patterns, and check they find the same words.
+#
+# The patterns are made from words in the list, with each letter turned
+# into a ? with probability BLANK percent, plus a pattern of nothing but ?
+# for each length from 1 to 20.  Every method reports the time it took to
+# index the words, the memory the index uses and its mean time per pattern, not counting the output.
+#
+# Environment:
+#   WORDS      word list (default test/words-large.txt)
+#   PATTERNS   number of patterns made from words (default 2000)
+#   BLANK      percent chance of each letter becoming a ? (default 50)
+#   METHODS    methods to compare (default "scan length trie bits")
+#   CROSS      program to run
+
+CROSS=${CROSS:-./cross}
+WORDS=${WORDS:-test/words-large.txt}
+PATTERNS=${PATTERNS:-2000}
+BLANK=${BLANK:-50}
+METHODS=${METHODS:-scan length trie bits}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+awk -v n="$PATTERNS" -v blank="$BLANK" 'BEGIN { srand(1) }
+  { list[NR] = $1 }
+  END {
+    for (i = 0; i < n; i++) {
+      w = list[int(rand() * NR) + 1]
+      pat = ""
+      for (j = 1; j <= length(w); j++) {
+        pat = pat (rand() * 100 < blank ? "?" : substr(w, j, 1))
+      }
+      print pat
+    }
+    for (len = 1; len <= 20; len++) {
+      pat = ""
+      for (j = 0; j < len; j++) {
+        pat = pat "?"
+      }
+      print pat
+    }
+  }' "$WORDS" > "$WORK/patterns"
+
+FIRST=""
+for METHOD in $METHODS; do
+  "$CROSS" -t -m "$METHOD" "$WORDS" < "$WORK/patterns" > "$WORK/$METHOD.out" 2> "$WORK/$METHOD.err"
+  echo "$METHOD: $(tr '\n' ';' < "$WORK/$METHOD.err" | sed 's/;$//; s/;/, /g')"
+  if [ -n "$FIRST" ] && ! cmp -s "$WORK/$FIRST.out" "$WORK/$METHOD.out"; then
+    echo "**** $METHOD found different words from $FIRST"
+    exit 1
+  fi
+  FIRST=${FIRST:-$METHOD}
+done
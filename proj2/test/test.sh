@@ -55,6 +55,47 @@ testCross() {
   return 0
 }
 
+# Function to run every method of the cross program against a word list
+# with a word of the given number of letters, and check they all find it
+# and the words around it
+testLongWord() {
+  TESTNO=$1
+  LETTERS=$2
+
+  LONG=$(head -c $LETTERS /dev/zero | tr '\0' 'a')
+  printf 'cat\n%sb\ndog\n' "$LONG" > words-long.txt
+  printf 'c?t\n?%s?\n' "${LONG:1}" > input-long.txt
+  printf 'pattern> cat\npattern> %sb\npattern> ' "$LONG" > expected-long.txt
+
+  for METHOD in scan length trie bits; do
+    rm -f output.txt stderr.txt
+
+    echo "Cross test $TESTNO: ./cross -m $METHOD words-long.txt < input-long.txt > output.txt 2> stderr.txt"
+    ./cross -m $METHOD words-long.txt < input-long.txt > output.txt 2> stderr.txt
+    STATUS=$?
+
+    # Make sure the program exited with the right exit status.
+    if [ $STATUS -ne 0 ]
+    then
+      echo "**** Cross test $TESTNO FAILED - incorrect exit status. Expected: 0 Got: $STATUS"
+      FAIL=1
+      continue
+    fi
+
+    # Make sure the output matches the expected output.
+    diff -q expected-long.txt output.txt >/dev/null 2>&1
+    if [ $? -ne 0 ]
+    then
+      echo "**** Cross test $TESTNO FAILED - stdout output didn't match expected"
+      FAIL=1
+      continue
+    fi
+
+    echo "Cross test $TESTNO PASS"
+  done
+  rm -f words-long.txt input-long.txt expected-long.txt
+}
+
 # Function to run the connect program against a test case and check
 # its output and exit status for correct behavior
 testConnect() {
@@ -108,7 +149,8 @@ testCross 4 words-large.txt 0
 testCross 5 words-med.txt 0
 testCross 6 words-bad6.txt 1
 testCross 7 words-bad7.txt 1
-testCross 8 words-bad8.txt 1
+testCross 8 words-bad8.txt 0
+testLongWord 9 1200000
 
 # Test the connect program.
 testConnect 1 0
@@ -0,0 +1,220 @@
+/**
+   @file trie.c
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Tries for the cross program's word list.  Every node is kept in one growing array and refers to
+   others by index, with each node's children in a list through their sibling links.  A word is
+   found under the trie for its length, at the node for its last letter, which keeps a list of
+   every word in the file with that spelling.  Matches come out of the walk in alphabetical order,
+   so they're sorted back into the order of the word list.  The walk keeps its own stack, rather
+   than recursing, so a word can be as long as there's memory for.
+ */
+
+#include "trie.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of nodes and words there's room for at first. */
+#define INITIAL_CAPACITY 1024
+
+/**
+   Add a node to the trie, with no children or words.
+   @param trie trie to add to.
+   @param letter the letter the node adds.
+   @return index of the node, or -1 if there isn't enough memory for it.
+ */
+static int addNode(Trie *trie, char letter)
+{
+  if (trie->count == trie->capacity) {
+    int capacity = trie->capacity ? trie->capacity * 2 : INITIAL_CAPACITY;
+    TrieNode *nodes = realloc(trie->nodes, capacity * sizeof(TrieNode));
+    if (!nodes) {
+      return -1;
+    }
+    trie->nodes = nodes;
+    trie->capacity = capacity;
+  }
+  TrieNode *node = &trie->nodes[trie->count];
+  node->letter = letter;
+  node->child = -1;
+  node->sibling = -1;
+  node->word = -1;
+  return trie->count++;
+}
+
+void initTrie(Trie *trie)
+{
+  trie->nodes = NULL;
+  trie->count = 0;
+  trie->capacity = 0;
+  trie->roots = NULL;
+  trie->maxLength = -1;
+  trie->same = NULL;
+  trie->words = 0;
+  trie->wordCapacity = 0;
+  trie->stack = NULL;
+}
+
+/**
+   Make sure there's a trie for words of the given length, adding empty ones up to it.
+   @param trie the tries.
+   @param len length of word.
+   @return false if there isn't enough memory.
+ */
+static bool makeRoots(Trie *trie, int len)
+{
+  if (len <= trie->maxLength) {
+    return true;
+  }
+  int *roots = realloc(trie->roots, (len + 1) * sizeof(int));
+  if (!roots) {
+    return false;
+  }
+  trie->roots = roots;
+  int *stack = realloc(trie->stack, (len + 1) * sizeof(int));
+  if (!stack) {
+    return false;
+  }
+  trie->stack = stack;
+  while (trie->maxLength < len) {
+    int root = addNode(trie, '\0');
+    if (root < 0) {
+      return false;
+    }
+    trie->roots[++trie->maxLength] = root;
+  }
+  return true;
+}
+
+bool addWord(Trie *trie, char const *word, int index)
+{
+  int len = strlen(word);
+  if (!makeRoots(trie, len)) {
+    return false;
+  }
+  if (trie->words == trie->wordCapacity) {
+    int capacity = trie->wordCapacity ? trie->wordCapacity * 2 : INITIAL_CAPACITY;
+    int *same = realloc(trie->same, capacity * sizeof(int));
+    if (!same) {
+      return false;
+    }
+    trie->same = same;
+    trie->wordCapacity = capacity;
+  }
+
+  // Follow the word's letters down from the root, adding the nodes that aren't there yet.
+  int node = trie->roots[len];
+  for (int i = 0; i < len; i++) {
+    int child = trie->nodes[node].child;
+    while (child >= 0 && trie->nodes[child].letter != word[i]) {
+      child = trie->nodes[child].sibling;
+    }
+    if (child < 0) {
+      child = addNode(trie, word[i]);
+      if (child < 0) {
+        return false;
+      }
+      trie->nodes[child].sibling = trie->nodes[node].child;
+      trie->nodes[node].child = child;
+    }
+    node = child;
+  }
+  trie->same[index] = trie->nodes[node].word;
+  trie->nodes[node].word = index;
+  trie->words++;
+  return true;
+}
+
+/**
+   Add the words that end at a node to the ones found.
+   @param trie the trie.
+   @param node the node.
+   @param found array to add the indices of the words to.
+   @param count number of words in found so far, updated as words are added.
+ */
+static void collect(Trie const *trie, int node, int *found, int *count)
+{
+  for (int w = trie->nodes[node].word; w >= 0; w = trie->same[w]) {
+    found[(*count)++] = w;
+  }
+}
+
+/**
+   Collect the words below a root that match a pattern of the same length, depth first.
+   For each depth down to the current one, the stack holds the next sibling still to be tried
+   there: the one after the child taken for a ?, or -1 for a letter, which only one child has.
+   @param trie the trie.
+   @param root root of the trie for the pattern's length.
+   @param pat the pattern.
+   @param len length of the pattern.
+   @param found array to add the indices of matching words to.
+   @return the number of words added.
+ */
+static int walk(Trie const *trie, int root, char const *pat, int len, int *found)
+{
+  int count = 0;
+  if (len == 0) {
+    collect(trie, root, found, &count);
+    return count;
+  }
+  int *next = trie->stack;
+  int depth = 0;
+  next[0] = trie->nodes[root].child;
+  while (depth >= 0) {
+    int child = next[depth];
+    while (child >= 0 && pat[depth] != '?' && trie->nodes[child].letter != pat[depth]) {
+      child = trie->nodes[child].sibling;
+    }
+    if (child < 0) {
+      depth--;
+      continue;
+    }
+    next[depth] = pat[depth] == '?' ? trie->nodes[child].sibling : -1;
+    if (depth + 1 == len) {
+      collect(trie, child, found, &count);
+    }
+    else {
+      next[++depth] = trie->nodes[child].child;
+    }
+  }
+  return count;
+}
+
+/**
+   Order word indices from lowest to highest.
+   @param a pointer to one index.
+   @param b pointer to another.
+   @return negative, zero or positive as a is less than, equal to or greater than b.
+ */
+static int lowerFirst(void const *a, void const *b)
+{
+  int x = *(int const *) a;
+  int y = *(int const *) b;
+  return x < y ? -1 : x > y;
+}
+
+int findWords(Trie const *trie, char const *pat, int *found)
+{
+  int len = strlen(pat);
+  if (len > trie->maxLength) {
+    return 0;
+  }
+  int count = walk(trie, trie->roots[len], pat, len, found);
+  qsort(found, count, sizeof(int), lowerFirst);
+  return count;
+}
+
+size_t trieMemory(Trie const *trie)
+{
+  // Each length has a root and a place on the stack.
+  return (size_t) trie->capacity * sizeof(TrieNode) + (trie->maxLength + 1) * 2 * sizeof(int) +
+         (size_t) trie->wordCapacity * sizeof(int);
+}
+
+void freeTrie(Trie *trie)
+{
+  free(trie->nodes);
+  free(trie->roots);
+  free(trie->same);
+  free(trie->stack);
+}
@@ -0,0 +1,87 @@
+/**
+   @file trie.h
+   @author Xiaohui Z Ellis (xzheng6)
+
+   Header file for the trie.c component, an index of the word list for the cross program.
+   Words are kept in a trie for each length, so a pattern only walks the branches that can
+   match it: a letter follows one child, and only a ? follows them all.
+ */
+
+#ifndef _TRIE_H_
+#define _TRIE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** A node of a trie, for one letter of the words below it. */
+typedef struct {
+  /** The letter this node adds. */
+  char letter;
+
+  /** Index of the first child, and of the next node with the same parent, or -1 if none. */
+  int child;
+  int sibling;
+
+  /** Index of the last word spelled out by the letters down to this node, or -1 if none. */
+  int word;
+} TrieNode;
+
+/** Tries holding a word list, one for each length of word. */
+typedef struct {
+  /** All the nodes, with the root of each trie among them. */
+  TrieNode *nodes;
+  int count;
+  int capacity;
+
+  /** Index of the root of the trie for each length, for lengths up to maxLength. */
+  int *roots;
+  int maxLength;
+
+  /** For each word, the index of the word before it with the same spelling, or -1 if none. */
+  int *same;
+  int words;
+  int wordCapacity;
+
+  /** Room for a walk to remember, at each depth, the next sibling to try, up to maxLength. */
+  int *stack;
+} Trie;
+
+/**
+   Set up an empty trie.
+   @param trie trie to set up.
+ */
+void initTrie(Trie *trie);
+
+/**
+   Add a word to the trie.  Words have to be added in order, with indices counting up from zero.
+   @param trie trie to add to.
+   @param word the word, of lowercase letters.
+   @param index index of the word in the word list.
+   @return false if there isn't enough memory for it.
+ */
+bool addWord(Trie *trie, char const *word, int index);
+
+/**
+   Find the words matching a pattern, where a ? matches any letter.
+   @param trie trie to look in.
+   @param pat the pattern.
+   @param found set to the indices of the matching words, in the order they were added.
+   It needs room for every word in the trie.
+   @return the number of matching words.
+ */
+int findWords(Trie const *trie, char const *pat, int *found);
+
+/**
+   Return the number of bytes of memory the trie uses.
+   @param trie the trie.
+   @return its size in bytes.
+ */
+size_t trieMemory(Trie const *trie);
+
+/**
+   Free the memory used by the given trie.
+   @param trie trie to free.
+ */
+void freeTrie(Trie *trie);
+
+#endif